@@ -20,5 +20,12 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/* later runs of the program called name resume from here */
+extern int32_t ece391_snapshot (const uint8_t* name);
+
+/* the back buffer vidmap maps after the screen, and the call that shows it */
+#define ECE391_VID_BACK_OFFSET 0x1000
+extern int32_t ece391_vid_flip (int32_t sync);
+
 #endif /* ECE391SYSCALL_H */
 
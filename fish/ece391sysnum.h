@@ -11,5 +11,8 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SNAPSHOT   21
+#define SYS_VID_FLIP   24
+#define SYS_USLEEP     25
 
 #endif /* ECE391SYSNUM_H */
@@ -8,6 +8,7 @@
 uint8_t *vmem_base_addr;
 uint8_t *mp1_set_video_mode (void);
 void add_frames(uint8_t *, uint8_t *, int32_t);
+void next_frame(int rtc_fd);
 void ece391_memset(void* memory, char c, int n);
 int32_t ece391_memcpy(void* dest, const void* src, int32_t n);
 
@@ -22,7 +23,7 @@ static struct mp1_blink_struct blink_array[80*25];
 
 int main(void)
 {
-    int rtc_fd, ret_val, i, garbage;
+    int rtc_fd, ret_val, i;
     struct mp1_blink_struct blink_struct;
 
     ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
@@ -35,12 +36,14 @@ int main(void)
 
     add_frames(file0, file1, rtc_fd);
 
+    /* the next fish starts here, with the frames already loaded */
+    ece391_snapshot((uint8_t*)"fish");
+
     ret_val = 32;
     ret_val = ece391_write(rtc_fd, &ret_val, 4);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        next_frame(rtc_fd);
     }
 
     blink_struct.on_char = 'I';
@@ -52,22 +55,19 @@ int main(void)
     mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        next_frame(rtc_fd);
     }
 
     mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        next_frame(rtc_fd);
     }
 
     mp1_ioctl(6*80+60, RTC_REMOVE);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        next_frame(rtc_fd);
     }
 
     ece391_close(rtc_fd);
@@ -147,16 +147,27 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
     }
 }
 
+/* mp1 draws into the back buffer, which is shown a whole frame at a time */
 uint8_t*
 mp1_set_video_mode (void)
 {
     if(ece391_vidmap(&vmem_base_addr) == -1) {
         return NULL;
     } else {
+        vmem_base_addr += ECE391_VID_BACK_OFFSET;
         return vmem_base_addr;
     }
 }
 
+void next_frame(int rtc_fd)
+{
+    int garbage;
+
+    ece391_read(rtc_fd, &garbage, 4);
+    mp1_rtc_tasklet(garbage);
+    ece391_vid_flip(0);
+}
+
 void* mp1_malloc(int32_t size)
 {
     int32_t i;
@@ -0,0 +1,263 @@
+/* apic.c - Local APIC and its timer
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "idt.h"
+#include "pit.h"
+#include "timer.h"
+#include "paging_init.h"
+#include "lib.h"
+#include "smp.h"
+
+/* the timer is reprogrammed with a single register write, where the PIT
+ * takes three port writes, and it counts finely enough for microsecond
+ * quanta. the 8259 keeps delivering the other devices through LINT0 */
+static volatile uint32_t* lapic;
+static uint32_t lapic_per_ms;	//timer counts in a millisecond
+
+/*
+ * uint32_t lapic_read(uint32_t reg)
+ *   DESCRIPTION: reads a local APIC register
+ *   INPUTS: reg - register offset
+ *   OUTPUTS: none
+ *   RETURN VALUE: the register's value
+ *   SIDE EFFECTS: none
+ */
+static inline uint32_t lapic_read(uint32_t reg) {
+	return lapic[reg >> 2];
+}
+
+/*
+ * void lapic_write(uint32_t reg, uint32_t val)
+ *   DESCRIPTION: writes a local APIC register
+ *   INPUTS: reg - register offset
+ *           val - value to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the local APIC
+ */
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+	lapic[reg >> 2] = val;
+}
+
+/*
+ * int32_t lapic_present(void)
+ *   DESCRIPTION: asks cpuid whether there is a local APIC
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: nonzero if there is one
+ *   SIDE EFFECTS: none
+ */
+static int32_t lapic_present(void) {
+	uint32_t eax = 1, ebx, ecx, edx;
+
+	asm volatile("cpuid"
+		: "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+	return edx & CPUID_FEAT_APIC;
+}
+
+/*
+ * void lapic_setup(uint32_t lint0)
+ *   DESCRIPTION: enables this cpu's local APIC and leaves its timer
+ *                stopped, in one shot mode on LAPIC_TIMER_ENTRY
+ *   INPUTS: lint0 - what LINT0 delivers, the 8259 on the boot cpu only
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the local APIC
+ */
+static void lapic_setup(uint32_t lint0) {
+	lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_ENTRY);
+	lapic_write(LAPIC_LVT_LINT0, lint0);
+	lapic_write(LAPIC_LVT_LINT1, LAPIC_DELIVER_NMI);
+	lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+	lapic_write(LAPIC_TIMER_INIT, 0);
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_ENTRY);
+	lapic_eoi();
+}
+
+/*
+ * int32_t lapic_init(void)
+ *   DESCRIPTION: maps and enables the boot cpu's local APIC, keeps the
+ *                8259 working through LINT0, and counts how fast the timer
+ *                runs against LAPIC_CALIBRATE_MS of the PIT. every cpu's
+ *                timer runs off the same bus clock, so this is done once
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if the cpu has no local APIC
+ *   SIDE EFFECTS: maps LAPIC_VADDR, busy waits for LAPIC_CALIBRATE_MS
+ */
+int32_t lapic_init(void) {
+	uint32_t lo, hi;
+
+	if (!lapic_present())
+		return ERROR;
+
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(APIC_BASE_MSR));
+	lo |= APIC_BASE_ENABLE;
+	asm volatile("wrmsr" : : "a"(lo), "d"(hi), "c"(APIC_BASE_MSR));
+
+	//registers must not be cached. every cpu finds its own local APIC at
+	//the same physical address
+	page_table[LAPIC_VADDR >> LOWER_12_BITS] = (lo & APIC_BASE_MASK) |
+		CACHE_DISABLE | WRITE_THROUGH | GLOBAL | READ_WRITE | PRESENT;
+	flush_tlb_page(LAPIC_VADDR);
+	lapic = (volatile uint32_t*)LAPIC_VADDR;
+
+	//count down from the top while the PIT times the window
+	lapic_setup(LAPIC_DELIVER_EXTINT);
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_ENTRY);
+	lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+	pit_delay(LAPIC_CALIBRATE_CLOCKS);
+	lapic_per_ms = (0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR)) / LAPIC_CALIBRATE_MS;
+	lapic_write(LAPIC_TIMER_INIT, 0);
+	if (lapic_per_ms == 0)
+		lapic_per_ms = 1;
+
+	//one shot mode, unmasked
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_ENTRY);
+	return 0;
+}
+
+/*
+ * void lapic_init_ap(void)
+ *   DESCRIPTION: enables an application processor's local APIC. LINT0 is
+ *                masked, device interrupts only go to the boot cpu
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the local APIC
+ */
+void lapic_init_ap(void) {
+	uint32_t lo, hi;
+
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(APIC_BASE_MSR));
+	lo |= APIC_BASE_ENABLE;
+	asm volatile("wrmsr" : : "a"(lo), "d"(hi), "c"(APIC_BASE_MSR));
+
+	lapic_setup(LAPIC_LVT_MASKED);
+}
+
+/*
+ * int32_t lapic_ready(void)
+ *   DESCRIPTION: tells whether lapic_init found and mapped a local APIC
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: nonzero if it did
+ *   SIDE EFFECTS: none
+ */
+int32_t lapic_ready(void) {
+	return lapic != NULL;
+}
+
+/*
+ * uint32_t lapic_id(void)
+ *   DESCRIPTION: reads the local APIC id of the cpu this runs on
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the id
+ *   SIDE EFFECTS: none
+ */
+uint32_t lapic_id(void) {
+	return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ * void lapic_send_icr(uint32_t apic_id, uint32_t cmd)
+ *   DESCRIPTION: writes the interrupt command register once the previous
+ *                command has been delivered
+ *   INPUTS: apic_id - destination cpu
+ *           cmd - low word of the command
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends an interprocessor interrupt
+ */
+static void lapic_send_icr(uint32_t apic_id, uint32_t cmd) {
+	while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+		asm volatile("pause");
+	lapic_write(LAPIC_ICR_HIGH, apic_id << LAPIC_ID_SHIFT);
+	lapic_write(LAPIC_ICR_LOW, cmd);
+}
+
+/*
+ * void lapic_send_ipi(uint32_t apic_id, uint32_t vector)
+ *   DESCRIPTION: interrupts another cpu
+ *   INPUTS: apic_id - destination cpu
+ *           vector - idt entry it takes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends an interprocessor interrupt
+ */
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector) {
+	lapic_send_icr(apic_id, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+/*
+ * void lapic_send_init(uint32_t apic_id)
+ *   DESCRIPTION: resets another cpu into its wait for a startup IPI
+ *   INPUTS: apic_id - destination cpu
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends an INIT IPI
+ */
+void lapic_send_init(uint32_t apic_id) {
+	lapic_send_icr(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+}
+
+/*
+ * void lapic_send_startup(uint32_t apic_id, uint32_t page)
+ *   DESCRIPTION: starts a cpu waiting after INIT, in real mode at
+ *                page:0000
+ *   INPUTS: apic_id - destination cpu
+ *           page - 4kB page below 1MB holding the start code
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends a startup IPI
+ */
+void lapic_send_startup(uint32_t apic_id, uint32_t page) {
+	lapic_send_icr(apic_id, LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | page);
+}
+
+/*
+ * void lapic_timer_arm(uint32_t us)
+ *   DESCRIPTION: starts a one shot, replacing whatever was counting
+ *   INPUTS: us - microseconds until the interrupt
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the timer
+ */
+void lapic_timer_arm(uint32_t us) {
+	uint32_t count;
+
+	//split so us * lapic_per_ms can't overflow
+	count = (us / 1000) * lapic_per_ms + (us % 1000) * lapic_per_ms / 1000;
+	lapic_write(LAPIC_TIMER_INIT, count ? count : 1);
+}
+
+/*
+ * void lapic_eoi(void)
+ *   DESCRIPTION: tells the local APIC the interrupt it delivered is done
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void lapic_eoi(void) {
+	lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * void lapic_timer_handler()
+ *   DESCRIPTION: handles the local APIC timer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: acknowledges the interrupt before the scheduler may
+ *                 switch away
+ */
+void lapic_timer_handler() {
+	lock_kernel();
+	lapic_eoi();
+	timer_interrupt();
+	unlock_kernel();
+}
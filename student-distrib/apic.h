@@ -0,0 +1,73 @@
+/* apic.h - Local APIC and its timer
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* where the local APIC's registers get mapped, the last 4kB page below
+ * the kernel, which every page directory shares */
+#define LAPIC_VADDR			0x003FF000
+
+#define CPUID_FEAT_APIC		0x200		//edx bit of cpuid 1, the cpu has a local APIC
+#define APIC_BASE_MSR		0x1B
+#define APIC_BASE_ENABLE	0x800
+#define APIC_BASE_MASK		0xFFFFF000
+
+/* register offsets */
+#define LAPIC_ID			0x020
+#define LAPIC_EOI			0x0B0
+#define LAPIC_SVR			0x0F0
+#define LAPIC_ICR_LOW		0x300
+#define LAPIC_ICR_HIGH		0x310
+#define LAPIC_LVT_TIMER		0x320
+#define LAPIC_LVT_LINT0		0x350
+#define LAPIC_LVT_LINT1		0x360
+#define LAPIC_TIMER_INIT	0x380
+#define LAPIC_TIMER_CUR		0x390
+#define LAPIC_TIMER_DIV		0x3E0
+
+#define LAPIC_SVR_ENABLE	0x100
+#define LAPIC_LVT_MASKED	0x10000
+#define LAPIC_DELIVER_EXTINT	0x700	//LINT0 passes the 8259's interrupts through
+#define LAPIC_DELIVER_NMI	0x400
+#define LAPIC_TIMER_DIV_16	0x3
+#define LAPIC_ID_SHIFT		24
+
+/* interrupt command register */
+#define LAPIC_ICR_FIXED		0x000
+#define LAPIC_ICR_INIT		0x500
+#define LAPIC_ICR_STARTUP	0x600
+#define LAPIC_ICR_PENDING	0x1000	//still being delivered
+#define LAPIC_ICR_ASSERT	0x4000
+
+/* the timer is calibrated against this much of the PIT at boot */
+#define LAPIC_CALIBRATE_MS	10
+#define LAPIC_CALIBRATE_CLOCKS	11932	//PIT input clocks in LAPIC_CALIBRATE_MS
+
+#define ERROR				-1
+
+/* Enables the local APIC and calibrates its timer, ERROR if there is none */
+int32_t lapic_init(void);
+/* Enables the local APIC of an application processor, calibrated already */
+void lapic_init_ap(void);
+/* Nonzero once lapic_init found a local APIC */
+int32_t lapic_ready(void);
+/* Local APIC id of the cpu this runs on */
+uint32_t lapic_id(void);
+/* Sends interrupt vector to the cpu with local APIC id apic_id */
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+/* Resets the cpu with apic_id, it waits for a startup IPI then */
+void lapic_send_init(uint32_t apic_id);
+/* Starts a cpu waiting after INIT in real mode at page << 12 */
+void lapic_send_startup(uint32_t apic_id, uint32_t page);
+/* Sets the timer to interrupt once, us microseconds from now */
+void lapic_timer_arm(uint32_t us);
+/* Signals the end of a local APIC interrupt */
+void lapic_eoi(void);
+
+extern void lapic_timer_handler();
+
+#endif /* _APIC_H */
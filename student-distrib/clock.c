@@ -0,0 +1,81 @@
+/* clock.c - Monotonic clock kept by the time-stamp counter
+ * vim:ts=4 noexpandtab
+ */
+
+#include "clock.h"
+#include "pit.h"
+#include "lib.h"
+
+/* reading the tsc is a single instruction, where the PIT and the RTC take
+ * several port accesses, so the kernel tells time with it and only uses
+ * the PIT once to learn how fast it runs */
+static uint64_t clock_base;		//tsc at the clock's zero
+static uint32_t tsc_per_us = 1;	//tsc cycles in a microsecond
+
+/*
+ * uint64_t div_u64(uint64_t n, uint32_t d)
+ *   DESCRIPTION: divides a 64 bit number by a 32 bit one with two divl,
+ *                since there is no libgcc to do 64 bit division for us
+ *   INPUTS: n - dividend
+ *           d - nonzero divisor
+ *   OUTPUTS: none
+ *   RETURN VALUE: n / d
+ *   SIDE EFFECTS: none
+ */
+static uint64_t div_u64(uint64_t n, uint32_t d) {
+	uint32_t hi = (uint32_t)(n >> 32);
+	uint32_t lo = (uint32_t)n;
+	uint32_t q_hi, q_lo, rem;
+
+	q_hi = hi / d;
+	rem = hi % d;
+	asm("divl %4"
+		: "=a"(q_lo), "=d"(rem)
+		: "a"(lo), "d"(rem), "rm"(d));
+	return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+/*
+ * void clock_init(void)
+ *   DESCRIPTION: counts the tsc cycles in CLOCK_CALIBRATE_US of the PIT
+ *                and starts the clock at zero
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: busy waits for CLOCK_CALIBRATE_US, uses PIT channel 2
+ */
+void clock_init(void) {
+	uint64_t start;
+
+	start = rdtsc64();
+	pit_delay(CLOCK_CALIBRATE_CLOCKS);
+	tsc_per_us = (uint32_t)(rdtsc64() - start) / CLOCK_CALIBRATE_US;
+	if (tsc_per_us == 0)
+		tsc_per_us = 1;
+
+	clock_base = rdtsc64();
+}
+
+/*
+ * uint64_t clock_us(void)
+ *   DESCRIPTION: reads the monotonic clock
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: microseconds since clock_init
+ *   SIDE EFFECTS: none
+ */
+uint64_t clock_us(void) {
+	return div_u64(rdtsc64() - clock_base, tsc_per_us);
+}
+
+/*
+ * uint32_t clock_tsc_per_us(void)
+ *   DESCRIPTION: gives the tsc rate clock_init measured
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: tsc cycles in a microsecond
+ *   SIDE EFFECTS: none
+ */
+uint32_t clock_tsc_per_us(void) {
+	return tsc_per_us;
+}
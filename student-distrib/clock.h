@@ -0,0 +1,23 @@
+/* clock.h - Monotonic clock kept by the time-stamp counter
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "types.h"
+
+/* the tsc is timed against this much of the PIT when the clock starts */
+#define CLOCK_CALIBRATE_US		10000
+#define CLOCK_CALIBRATE_CLOCKS	11932	//PIT input clocks in CLOCK_CALIBRATE_US
+
+#define ERROR					-1
+
+/* Measures the tsc rate against the PIT and starts the clock at zero */
+void clock_init(void);
+/* Microseconds since clock_init */
+uint64_t clock_us(void);
+/* Tsc cycles in a microsecond, as measured by clock_init */
+uint32_t clock_tsc_per_us(void);
+
+#endif /* _CLOCK_H */
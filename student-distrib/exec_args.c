@@ -0,0 +1,250 @@
+/* exec_args.c - argv/envp vectors on a new program's user stack
+ * vim:ts=4 noexpandtab
+ */
+
+#include "exec_args.h"
+#include "paging_init.h"
+#include "lib.h"
+
+/* environment of processes that have no parent to inherit one from */
+static const int8_t* default_env[] = {"SHELL=shell", NULL};
+
+/*
+ * int32_t add_string(exec_args_t* args, const int8_t* s, pcb_t* pcb)
+ *   DESCRIPTION: appends s and its NUL to the string block
+ *   INPUTS: args - block to append to
+ *           s - string to copy
+ *           pcb - NULL for a kernel string, otherwise the process whose
+ *                 memory s is in, it is checked as it is read
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if the block is full or s is bad
+ *   SIDE EFFECTS: grows args->size
+ */
+static int32_t add_string(exec_args_t* args, const int8_t* s, pcb_t* pcb) {
+	while (1) {
+		if (pcb != NULL && !user_addr_ok(pcb, (uint32_t)s))
+			return ERROR;
+		if (args->size >= ARG_MAX)
+			return ERROR;
+		args->strings[args->size++] = *s;
+		if (*s++ == '\0')
+			return 0;
+	}
+}
+
+/*
+ * int32_t parse_exec_args(const uint8_t* command, exec_args_t* args)
+ *   DESCRIPTION: splits command at spaces. argv[0] is the program name
+ *   INPUTS: command - the command line passed to execute/spawn/exec
+ *           args - block to fill in
+ *   OUTPUTS: args
+ *   RETURN VALUE: 0 on success, ERROR if command is empty or too long
+ *   SIDE EFFECTS: none
+ */
+int32_t parse_exec_args(const uint8_t* command, exec_args_t* args) {
+	uint32_t i = 0;
+
+	args->argc = 0;
+	args->envc = 0;
+	args->size = 0;
+
+	while (1) {
+		while (command[i] == ' ')
+			i++;
+		if (command[i] == '\0')
+			break;
+
+		//leave room for the NUL
+		while (command[i] != ' ' && command[i] != '\0') {
+			if (args->size + 1 >= ARG_MAX)
+				return ERROR;
+			args->strings[args->size++] = command[i++];
+		}
+		args->strings[args->size++] = '\0';
+		args->argc++;
+	}
+
+	return (args->argc == 0) ? ERROR : 0;
+}
+
+/*
+ * int32_t inherit_env(pcb_t* pcb, exec_args_t* args)
+ *   DESCRIPTION: copies the environment strings pcb was started with. they
+ *                are read through the current page directory, so pcb's
+ *                address space has to be the loaded one
+ *   INPUTS: pcb - process to inherit from, NULL for the default environment
+ *           args - block with argv already in it
+ *   OUTPUTS: args
+ *   RETURN VALUE: 0 on success, ERROR if the strings do not fit or pcb's
+ *                 envp has been overwritten with garbage
+ *   SIDE EFFECTS: none
+ */
+int32_t inherit_env(pcb_t* pcb, exec_args_t* args) {
+	uint32_t* envp;
+	uint32_t i;
+
+	if (pcb == NULL || pcb->envp == 0) {
+		for (i = 0; default_env[i] != NULL; i++, args->envc++)
+			if (add_string(args, default_env[i], NULL) == ERROR)
+				return ERROR;
+		return 0;
+	}
+
+	envp = (uint32_t*)pcb->envp;
+	for (i = 0; ; i++, args->envc++) {
+		if (!user_addr_ok(pcb, (uint32_t)&envp[i]))
+			return ERROR;
+		if (envp[i] == 0)
+			return 0;
+		if (add_string(args, (const int8_t*)envp[i], pcb) == ERROR)
+			return ERROR;
+	}
+}
+
+/*
+ * uint32_t write_exec_args(pcb_t* pcb, exec_args_t* args, uint32_t vec)
+ *   DESCRIPTION: writes the argv and envp arrays at vec with the strings
+ *                right after them, and argc, argv, envp just below vec
+ *   INPUTS: pcb - the process, remembers where argv and envp are
+ *           args - what to copy
+ *           vec - user address for argv, the pages from 12 bytes below it
+ *                 up to past the strings must be writable
+ *   OUTPUTS: none
+ *   RETURN VALUE: the user esp main is called with
+ *   SIDE EFFECTS: none
+ */
+static uint32_t write_exec_args(pcb_t* pcb, exec_args_t* args, uint32_t vec) {
+	uint32_t strings, sp, off, i;
+	uint32_t* argv;
+	uint32_t* envp;
+	uint32_t* top;
+
+	strings = vec + (args->argc + 1 + args->envc + 1) * sizeof(uint32_t);
+	sp = vec - 3 * sizeof(uint32_t);
+
+	memcpy((void*)strings, args->strings, args->size);
+
+	argv = (uint32_t*)vec;
+	envp = argv + args->argc + 1;
+	off = 0;
+	for (i = 0; i < args->argc; i++) {
+		argv[i] = strings + off;
+		off += strlen((const int8_t*)(strings + off)) + 1;
+	}
+	argv[args->argc] = 0;
+	for (i = 0; i < args->envc; i++) {
+		envp[i] = strings + off;
+		off += strlen((const int8_t*)(strings + off)) + 1;
+	}
+	envp[args->envc] = 0;
+
+	top = (uint32_t*)sp;
+	top[0] = args->argc;
+	top[1] = (uint32_t)argv;
+	top[2] = (uint32_t)envp;
+
+	pcb->argc = args->argc;
+	pcb->argv = (uint32_t)argv;
+	pcb->envp = (uint32_t)envp;
+	return sp;
+}
+
+/*
+ * uint32_t push_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args)
+ *   DESCRIPTION: lays the strings, the argv and envp arrays and then
+ *                argc, argv, envp out at the top of the user stack, so the
+ *                call to main in _start finds them as its arguments
+ *   INPUTS: pg_dir - page directory of the new program, must be loaded
+ *           pcb - the process, remembers where argv and envp are
+ *           args - what to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: the initial user esp, 0 if memory ran out
+ *   SIDE EFFECTS: maps the top stack pages
+ */
+uint32_t push_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args) {
+	uint32_t vec, vaddr;
+
+	vec = (USER_STACK_END - args->size - (args->argc + 1 + args->envc + 1) * sizeof(uint32_t)) &
+		  ~(sizeof(uint32_t) - 1);
+
+	//the page fault handler maps into the running process, which is not
+	//this one yet, so back the pages before writing them
+	for (vaddr = (vec - 3 * sizeof(uint32_t)) & HIGH_20_MASK; vaddr < USER_STACK_END; vaddr += ALIGNED_4KB)
+		if (unshare_user_page(pg_dir, vaddr) == ERROR)
+			return 0;
+
+	return write_exec_args(pcb, args, vec);
+}
+
+/*
+ * int32_t replace_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args)
+ *   DESCRIPTION: gives a snapshot clone the arguments it was started with.
+ *                they go over the snapshot's own, between its argv and the
+ *                top of the stack, so argc, argv and envp stay where main
+ *                already reads them from
+ *   INPUTS: pg_dir - page directory of the clone, must be loaded
+ *           pcb - the clone, still with the snapshot's argv
+ *           args - what to copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if args need more room than the
+ *                 snapshot's took or memory ran out
+ *   SIDE EFFECTS: the top stack pages stop being shared with the snapshot
+ */
+int32_t replace_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args) {
+	uint32_t vec = pcb->argv, vaddr;
+
+	if (vec < USER_STACK_START + 3 * sizeof(uint32_t) ||
+		vec + (args->argc + 1 + args->envc + 1) * sizeof(uint32_t) + args->size > USER_STACK_END)
+		return ERROR;
+
+	for (vaddr = (vec - 3 * sizeof(uint32_t)) & HIGH_20_MASK; vaddr < USER_STACK_END; vaddr += ALIGNED_4KB)
+		if (unshare_user_page(pg_dir, vaddr) == ERROR)
+			return ERROR;
+
+	write_exec_args(pcb, args, vec);
+	return 0;
+}
+
+/*
+ * int32_t join_user_args(pcb_t* pcb, uint8_t* buf, int32_t nbytes)
+ *   DESCRIPTION: joins argv[1..] with single spaces, which is what getargs
+ *                used to hand out. reads the running process's memory
+ *   INPUTS: pcb - the running process
+ *           buf - where the string goes
+ *           nbytes - size of buf
+ *   OUTPUTS: buf
+ *   RETURN VALUE: 0 on success, ERROR if there are no arguments, they do
+ *                 not fit, or argv was overwritten with garbage
+ *   SIDE EFFECTS: none
+ */
+int32_t join_user_args(pcb_t* pcb, uint8_t* buf, int32_t nbytes) {
+	uint32_t* argv = (uint32_t*)pcb->argv;
+	int8_t* s;
+	uint32_t i;
+	int32_t len = 0;
+
+	if (pcb->argc < 2)
+		return ERROR;
+
+	for (i = 1; i < pcb->argc; i++) {
+		if (!user_addr_ok(pcb, (uint32_t)&argv[i]))
+			return ERROR;
+		if (i > 1) {
+			if (len + 1 >= nbytes)
+				return ERROR;
+			buf[len++] = ' ';
+		}
+		for (s = (int8_t*)argv[i]; ; s++) {
+			if (!user_addr_ok(pcb, (uint32_t)s))
+				return ERROR;
+			if (*s == '\0')
+				break;
+			if (len + 1 >= nbytes)
+				return ERROR;
+			buf[len++] = *s;
+		}
+	}
+
+	buf[len] = '\0';
+	return 0;
+}
@@ -0,0 +1,38 @@
+/* exec_args.h - argv/envp vectors on a new program's user stack
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _EXEC_ARGS_H
+#define _EXEC_ARGS_H
+
+#include "types.h"
+#include "pcb.h"
+#include "user_mem.h"
+
+/* bytes of argument and environment strings a program can be started with */
+#define ARG_MAX				1024
+
+#define ERROR				-1
+
+/* argument and environment strings collected in the kernel while the old
+ * address space is still around. NUL separated, argv first then envp */
+typedef struct exec_args_t
+{
+	uint32_t argc;
+	uint32_t envc;
+	uint32_t size;				//bytes of strings used
+	int8_t strings[ARG_MAX];
+} exec_args_t;
+
+/* Splits a command line into argv */
+int32_t parse_exec_args(const uint8_t* command, exec_args_t* args);
+/* Appends the environment of pcb (or the default one) as envp */
+int32_t inherit_env(pcb_t* pcb, exec_args_t* args);
+/* Copies args onto the user stack of pg_dir, returns the new user esp */
+uint32_t push_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args);
+/* Swaps a snapshot clone's argv and envp for args, in place */
+int32_t replace_exec_args(uint32_t* pg_dir, pcb_t* pcb, exec_args_t* args);
+/* Rebuilds the old single string form of argv[1..] for getargs */
+int32_t join_user_args(pcb_t* pcb, uint8_t* buf, int32_t nbytes);
+
+#endif /* _EXEC_ARGS_H */
@@ -1,5 +1,7 @@
 #include "file_sys.h"
 #include "pcb.h"
+#include "sched.h"
+#include "smp.h"
 
 // Global variable for the boot block
 boot_block_t boot_block;
@@ -321,7 +323,7 @@ print_dentry (dentry_t* dentry)
 */
 int32_t read_file(int32_t fd, void* buf, int32_t nbytes)
 {
-	file_desc_t file_desc = pcb_term[curr_term_idx]->file_desc_array[fd];
+	file_desc_t file_desc = this_rq()->curr_process->file_desc_array[fd];
 	// read data
 	int32_t ret = read_data (file_desc.inode, file_desc.file_position, (uint8_t*) buf, nbytes);
 
@@ -331,7 +333,7 @@ int32_t read_file(int32_t fd, void* buf, int32_t nbytes)
 	}
 
 	// update file position
-	pcb_term[curr_term_idx]->file_desc_array[fd].file_position += ret;
+	this_rq()->curr_process->file_desc_array[fd].file_position += ret;
 	return ret;
 }
 
@@ -382,7 +384,7 @@ int32_t read_directory(int32_t fd, void* buf, int32_t nbytes)
 {
 	dentry_t d;
 	// Gets the file index - used to index the global array of all the dentries
-	file_desc_t file_desc = pcb_term[curr_term_idx]->file_desc_array[fd];
+	file_desc_t file_desc = this_rq()->curr_process->file_desc_array[fd];
 	int32_t file_index = file_desc.file_position;
 
 	// check if end of file
@@ -395,7 +397,7 @@ int32_t read_directory(int32_t fd, void* buf, int32_t nbytes)
 	strncpy((int8_t*)buf, d.file_name, MAX_STRING_LEN);
 
 	// Increment the index
-	pcb_term[curr_term_idx]->file_desc_array[fd].file_position++;
+	this_rq()->curr_process->file_desc_array[fd].file_position++;
 	return strlen_mod((const int8_t*)buf);
 
 }
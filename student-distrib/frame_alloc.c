@@ -0,0 +1,253 @@
+/* frame_alloc.c - Allocator for 4KB physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frame_alloc.h"
+#include "lib.h"
+#include "stats.h"
+#include "spinlock.h"
+
+//stack of free frame numbers, so allocating and freeing are both O(1)
+static uint16_t free_frames[MAX_FRAMES];
+static uint32_t num_free;
+
+//number of mappings (or other owners) of each frame
+static uint16_t frame_refs[MAX_FRAMES];
+
+//number of frames that actually exist in physical memory
+static uint32_t num_frames;
+
+//guards everything here. the idle task zeroes frames without the kernel
+//lock, and the page fault handler allocates under it
+static spinlock_t frame_lock = SPINLOCK_INIT("frame", LOCK_RANK_FRAME);
+
+//frames that were zeroed while the cpu was idle. they are allocated (one
+//reference each) so the free list never hands them out half cleared
+static uint32_t zeroed_frames[ZERO_POOL_SIZE];
+static uint32_t num_zeroed;
+
+/*
+ * int32_t frame_index(uint32_t frame)
+ *   DESCRIPTION: converts a physical address to an index into the pool
+ *   INPUTS: frame - physical address of a frame
+ *   OUTPUTS: none
+ *   RETURN VALUE: the index, ERROR if frame is not a pool frame
+ *   SIDE EFFECTS: none
+ */
+static int32_t frame_index(uint32_t frame) {
+	if (frame < FRAME_POOL_START || frame >= FRAME_POOL_START + num_frames * FRAME_SIZE)
+		return ERROR;
+	if (frame & (FRAME_SIZE - 1))
+		return ERROR;
+	return (frame - FRAME_POOL_START) / FRAME_SIZE;
+}
+
+/*
+ * void frame_alloc_init(uint32_t mem_end)
+ *   DESCRIPTION: puts every frame of the pool that is backed by memory on
+ *                the free list
+ *   INPUTS: mem_end - first physical address past the end of memory
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: resets the allocator
+ */
+void frame_alloc_init(uint32_t mem_end) {
+	uint32_t i;
+
+	if (mem_end > FRAME_POOL_END || mem_end < FRAME_POOL_START)
+		mem_end = FRAME_POOL_END;
+	num_frames = (mem_end - FRAME_POOL_START) / FRAME_SIZE;
+
+	//push in reverse so the lowest frames are handed out first
+	num_free = 0;
+	num_zeroed = 0;
+	for (i = num_frames; i > 0; i--) {
+		free_frames[num_free++] = i - 1;
+		frame_refs[i - 1] = 0;
+	}
+}
+
+/*
+ * uint32_t frame_alloc()
+ *   DESCRIPTION: takes a frame off the free list. the contents are whatever
+ *                the last owner left there. once the free list is empty the
+ *                zeroed frames are handed out too
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame, 0 if the pool is empty
+ *   SIDE EFFECTS: shrinks the free list
+ */
+uint32_t frame_alloc() {
+	uint32_t flags, frame = 0;
+
+	flags = spin_lock_irqsave(&frame_lock);
+	if (num_free > 0) {
+		--num_free;
+		frame_refs[free_frames[num_free]] = 1;
+		frame = FRAME_POOL_START + free_frames[num_free] * FRAME_SIZE;
+	} else if (num_zeroed > 0) {
+		frame = zeroed_frames[--num_zeroed];
+		kstats.zero_pool_depth = num_zeroed;
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	return frame;
+}
+
+/*
+ * uint32_t frame_alloc_zeroed()
+ *   DESCRIPTION: allocates a frame full of zeroes. frames zeroed ahead of
+ *                time by zero_pool_refill are used first, so the fault path
+ *                usually skips the memset
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame, 0 if the pool is empty
+ *   SIDE EFFECTS: updates the zero pool counters
+ */
+uint32_t frame_alloc_zeroed() {
+	uint32_t flags, frame = 0;
+
+	flags = spin_lock_irqsave(&frame_lock);
+	if (num_zeroed > 0) {
+		frame = zeroed_frames[--num_zeroed];
+		kstats.zero_pool_depth = num_zeroed;
+		kstats.zero_pool_hits++;
+	} else {
+		kstats.zero_pool_misses++;
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	if (frame == 0 && (frame = frame_alloc()) != 0)
+		memset((void*)frame, 0, FRAME_SIZE);
+
+	return frame;
+}
+
+/*
+ * int32_t zero_pool_refill()
+ *   DESCRIPTION: zeroes one free frame and adds it to the zero pool. meant
+ *                for the scheduler when nothing is runnable, so the memset
+ *                runs on time nobody else wanted. the idle task calls it
+ *                with interrupts on and without the kernel lock
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a frame was zeroed, 0 if there was nothing to do
+ *   SIDE EFFECTS: moves a frame from the free list to the zero pool
+ */
+int32_t zero_pool_refill() {
+	uint32_t flags, frame;
+	int32_t pooled;
+
+	//never drain the zero pool into itself through frame_alloc
+	if (num_zeroed >= ZERO_POOL_SIZE || num_free == 0)
+		return 0;
+	if ((frame = frame_alloc()) == 0)
+		return 0;
+
+	memset((void*)frame, 0, FRAME_SIZE);
+
+	flags = spin_lock_irqsave(&frame_lock);
+	pooled = num_zeroed < ZERO_POOL_SIZE;
+	if (pooled) {
+		zeroed_frames[num_zeroed++] = frame;
+		kstats.zero_pool_depth = num_zeroed;
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	//someone else filled the pool while we were zeroing
+	if (!pooled)
+		frame_free(frame);
+	return 1;
+}
+
+/*
+ * int32_t frame_ref(uint32_t frame)
+ *   DESCRIPTION: records another owner of an allocated frame, e.g. when it
+ *                gets mapped into a second address space
+ *   INPUTS: frame - physical address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if frame is not an allocated pool frame
+ *   SIDE EFFECTS: bumps the reference count
+ */
+int32_t frame_ref(uint32_t frame) {
+	uint32_t flags;
+	int32_t idx, ret = 0;
+
+	if ((idx = frame_index(frame)) == ERROR)
+		return ERROR;
+
+	flags = spin_lock_irqsave(&frame_lock);
+	if (frame_refs[idx] == 0)
+		ret = ERROR;
+	else
+		frame_refs[idx]++;
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	return ret;
+}
+
+/*
+ * int32_t frame_free(uint32_t frame)
+ *   DESCRIPTION: drops one reference to a frame and gives it back to the
+ *                pool once nobody holds it anymore
+ *   INPUTS: frame - physical address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if frame is not an allocated pool frame
+ *   SIDE EFFECTS: may grow the free list
+ */
+int32_t frame_free(uint32_t frame) {
+	uint32_t flags;
+	int32_t idx, ret = 0;
+
+	if ((idx = frame_index(frame)) == ERROR)
+		return ERROR;
+
+	flags = spin_lock_irqsave(&frame_lock);
+	if (frame_refs[idx] == 0)
+		ret = ERROR;
+	else if (--frame_refs[idx] == 0)
+		free_frames[num_free++] = idx;
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	return ret;
+}
+
+/*
+ * uint32_t frame_refcount(uint32_t frame)
+ *   DESCRIPTION: reports how many owners a frame has
+ *   INPUTS: frame - physical address of a pool frame
+ *   OUTPUTS: none
+ *   RETURN VALUE: the reference count, 0 for free or non-pool frames
+ *   SIDE EFFECTS: none
+ */
+uint32_t frame_refcount(uint32_t frame) {
+	int32_t idx;
+
+	if ((idx = frame_index(frame)) == ERROR)
+		return 0;
+	return frame_refs[idx];
+}
+
+/*
+ * uint32_t frames_available()
+ *   DESCRIPTION: reports how many frames can still be allocated
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of free frames, zeroed or not
+ *   SIDE EFFECTS: none
+ */
+uint32_t frames_available() {
+	return num_free + num_zeroed;
+}
+
+/*
+ * uint32_t frames_total()
+ *   DESCRIPTION: size of the pool, free or not
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of frames backed by physical memory
+ *   SIDE EFFECTS: none
+ */
+uint32_t frames_total() {
+	return num_frames;
+}
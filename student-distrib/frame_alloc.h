@@ -0,0 +1,44 @@
+/* frame_alloc.h - Allocator for 4KB physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAME_ALLOC_H
+#define _FRAME_ALLOC_H
+
+#include "types.h"
+#include "paging_init.h"
+
+#define FRAME_SIZE			ALIGNED_4KB
+
+/* physical memory handed out in 4KB frames. everything above the kernel's
+ * 4MB page is pool memory and is identity mapped (supervisor only) in every
+ * page directory, so the kernel can zero and copy frames directly */
+#define FRAME_POOL_START	0x00800000
+#define FRAME_POOL_END		0x04000000
+#define MAX_FRAMES			((FRAME_POOL_END - FRAME_POOL_START) / FRAME_SIZE)
+
+/* frames kept zeroed ahead of time for frame_alloc_zeroed */
+#define ZERO_POOL_SIZE		64
+
+#define ERROR				-1
+
+/* Builds the free list, only using frames below mem_end */
+void frame_alloc_init(uint32_t mem_end);
+/* Takes a frame off the free list, returns its physical address or 0 */
+uint32_t frame_alloc();
+/* Like frame_alloc, but the frame is filled with zeroes */
+uint32_t frame_alloc_zeroed();
+/* Zeroes one more frame for the pool, called while the cpu has nothing to do */
+int32_t zero_pool_refill();
+/* Adds a reference to a frame that is mapped in more than one place */
+int32_t frame_ref(uint32_t frame);
+/* Drops a reference, the frame goes back on the free list with the last one */
+int32_t frame_free(uint32_t frame);
+/* Number of references held on a frame */
+uint32_t frame_refcount(uint32_t frame);
+/* Number of frames left on the free list */
+uint32_t frames_available();
+/* Number of frames the pool was set up with */
+uint32_t frames_total();
+
+#endif /* _FRAME_ALLOC_H */
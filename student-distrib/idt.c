@@ -90,7 +90,11 @@ idt_init() {
 	SET_IDT_ENTRY(idt[11], NP);
 	SET_IDT_ENTRY(idt[12], SS);
 	SET_IDT_ENTRY(idt[13], GP);
-	SET_IDT_ENTRY(idt[14], PF);
+	//page faults can be resolved (demand paging), so they go through a stub
+	//that falls back to PF. use an interrupt gate so a fault is fixed up
+	//before anything else gets to run
+	SET_IDT_ENTRY(idt[14], page_fault_interrupt);
+	idt[14].reserved3 = 0;
 	SET_IDT_ENTRY(idt[15], SPURIONS);
 	SET_IDT_ENTRY(idt[16], MF);
 	SET_IDT_ENTRY(idt[17], AC);
@@ -101,8 +105,14 @@ idt_init() {
 	SET_IDT_ENTRY(idt[PIT_ENTRY], pit_interrupt);
 	SET_IDT_ENTRY(idt[KEYBOARD_ENTRY], keyboard_interrupt);
 	SET_IDT_ENTRY(idt[RTC_ENTRY], rtc_interrupt);
-	//load the syscall handler onto the IDT
+	SET_IDT_ENTRY(idt[LAPIC_TIMER_ENTRY], lapic_timer_interrupt);
+	SET_IDT_ENTRY(idt[LAPIC_SPURIOUS_ENTRY], lapic_spurious_interrupt);
+	SET_IDT_ENTRY(idt[RESCHED_IPI_ENTRY], resched_ipi_interrupt);
+	SET_IDT_ENTRY(idt[TLB_IPI_ENTRY], tlb_ipi_interrupt);
+	//load the syscall handler onto the IDT. a trap gate, so interrupts
+	//stay on in system calls, see smp.c
 	SET_IDT_ENTRY(idt[SYS_CALL_ENTRY], syscall_interrupt);
+	idt[SYS_CALL_ENTRY].reserved3 = 1;
 
 	//Load the interrupt descripter table register.
 	lidt(idt_desc_ptr);
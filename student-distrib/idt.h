@@ -25,6 +25,10 @@ void handle_exception() {							\
 #define PIT_ENTRY		0x20
 #define KEYBOARD_ENTRY	0x21
 #define RTC_ENTRY		0x28
+#define LAPIC_TIMER_ENTRY		0x40
+#define RESCHED_IPI_ENTRY		0x41
+#define TLB_IPI_ENTRY			0x42
+#define LAPIC_SPURIOUS_ENTRY	0xFF
 #define SYS_CALL_ENTRY	0x80
 
 /* Initialize the IDT with each of the interrupt and exception handlers */
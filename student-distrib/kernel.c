@@ -16,14 +16,23 @@
 #include "systemcalls.h"
 #include "pcb.h"
 #include "pit.h"
+#include "timer.h"
 #include "sched.h"
+#include "stats.h"
+#include "frame_alloc.h"
+#include "shm.h"
+#include "snapshot.h"
+#include "smp.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags,bit)	((flags) & (1 << (bit)))
+/* Physical address that multiboot's mem_upper is measured from */
+#define MEM_UPPER_BASE			0x100000
 
 unsigned int mod_start;
 unsigned int mod_end;
+unsigned int mem_end;
 
 void sched_init();
 void init_funcs();
@@ -34,6 +43,9 @@ void
 entry (unsigned long magic, unsigned long addr)
 {
 	multiboot_info_t *mbi;
+	uint32_t tid;
+
+	boot_tsc = rdtsc();
 
 	/* Clear the screen. */
 	clear();
@@ -52,9 +64,12 @@ entry (unsigned long magic, unsigned long addr)
 	printf ("flags = 0x%#x\n", (unsigned) mbi->flags);
 
 	/* Are mem_* valid? */
-	if (CHECK_FLAG (mbi->flags, 0))
+	if (CHECK_FLAG (mbi->flags, 0)) {
 		printf ("mem_lower = %uKB, mem_upper = %uKB\n",
 				(unsigned) mbi->mem_lower, (unsigned) mbi->mem_upper);
+		/* mem_upper counts the KB above the first MB */
+		mem_end = MEM_UPPER_BASE + ((unsigned) mbi->mem_upper << 10);
+	}
 
 	/* Is boot_device valid? */
 	if (CHECK_FLAG (mbi->flags, 1))
@@ -160,13 +175,17 @@ entry (unsigned long magic, unsigned long addr)
 		tss.ss0 = KERNEL_DS;
 		tss.esp0 = 0x800000;
 		ltr(KERNEL_TSS);
+		smp_init_bsp();
 	}
 	init_funcs();
 
-	execute((const uint8_t*)"shell");
-
-	/* Spin (nicely, so we don't chew up cycles) */
-	asm volatile(".1: hlt; jmp .1;");
+	// bring up every terminal's shell now rather than on the first
+	// alt+F2/F3, then become the idle task, which runs them
+	cli();
+	for (tid = 0; tid < NUM_TERMS; tid++)
+		if (boot_shell(tid) == ERROR)
+			printf("no shell on terminal %d\n", tid);
+	sched_start();
 }
 
 void
@@ -185,6 +204,11 @@ init_funcs ()
 	// Initialize paging
 	intialize_paging();
 
+	// Hand the physical memory above the kernel to the frame allocator
+	frame_alloc_init(mem_end);
+	shm_init();
+	snapshot_init();
+
 	init_file_sys(mod_start, mod_end);
 
 	/* Enable interrupts */
@@ -198,6 +222,15 @@ init_funcs ()
 	//init scheduler
 	sched_init();
 
+	//reset the performance counters
+	stats_init();
+
+	//move the scheduler tick onto the local APIC and tsc, after paging
+	timer_init();
+
+	//start the other processors, each idling on its own run queue
+	smp_init();
+
 	init_terms();
 
 
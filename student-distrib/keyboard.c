@@ -10,6 +10,8 @@
 #include "pcb.h"
 #include "systemcalls.h"
 #include "sched.h"
+#include "frame_alloc.h"
+#include "smp.h"
 
 
 // active high flag for caps lock
@@ -61,7 +63,7 @@ get_scan_code()
 /*
  *  char get_char
  *   DESCRIPTION: Looks up scan code in the scancode2char array
- *   INPUTS: none
+ *   INPUTS: c - scan code the keyboard sent
  *   OUTPUTS: none
  *   RETURN VALUE: The character represented by the scan code
  *   SIDE EFFECTS: none
@@ -69,7 +71,7 @@ get_scan_code()
  * Inspiration drawn from: http://wiki.osdev.org/PS/2_Keyboard
  */
 char
-get_char()
+get_char(unsigned char c)
 {
 
     /* Source: http://www.osdever.net/bkerndev/Docs/keyboard.htm */
@@ -154,8 +156,6 @@ get_char()
         0,  /* All other keys are undefined */
     };
 
-    unsigned char c = get_scan_code();
-
     /* "Edge" cases (non-printable characters) */
 
     // enable caps lock if it is disabled
@@ -219,41 +219,6 @@ get_char()
     }
 
 
-    /* Switch terminals combination*/
-    if(alt_pressed == 1){
-        switch(c){
-            case F1_SC:
-                switch_term(0);
-                return 0;
-            case F2_SC:
-                if(scheduler.size >= MAX_PROG_NUM && terminals[1].active == INACTIVE)
-                    return 0;
-                switch_term(1);
-                if(curr_term->active == INACTIVE) {
-                    curr_term->active = ACTIVE;
-                    send_eoi(KEYBOARD_IRQ);  // signal PIC
-                    clear();
-                    if(execute((const uint8_t*)"shell") == ERROR)
-                        curr_term->active = INACTIVE;
-                }
-                return 0;
-            case F3_SC:
-                if(scheduler.size >= MAX_PROG_NUM && terminals[2].active == INACTIVE)
-                    return 0;
-                switch_term(2);
-                if(curr_term->active == INACTIVE) {
-                    curr_term->active = ACTIVE;
-                    send_eoi(KEYBOARD_IRQ);  // signal PIC
-                    clear();
-                    if(execute((const uint8_t*)"shell") == ERROR)
-                        curr_term->active = INACTIVE;
-                }
-                return 0;
-        }
-    }
-
-
-
     /* General case (printable characters) */
     if(c < NUM_KEYS){
 
@@ -328,22 +293,64 @@ erase_n_chars(int n){
 
 
 
+/*
+ * int32_t switch_term_key
+ *   DESCRIPTION: Checks for the Alt + F1/F2/F3 terminal switch
+ *   INPUTS: c - scan code the keyboard sent
+ *   OUTPUTS: none
+ *   RETURN VALUE: terminal to switch to, or -1 for any other key
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+switch_term_key(unsigned char c)
+{
+    if(alt_pressed == 1){
+        switch(c){
+            case F1_SC:     return 0;
+            // every terminal got its shell at boot, so this is just a redraw
+            case F2_SC:     return 1;
+            case F3_SC:     return 2;
+        }
+    }
+    return -1;
+}
+
 /*
  * void keyboard_int_handler
  *   DESCRIPTION: Handles keyboard interrupts
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Signals that interrupt has been handled to KEYBOARD_IRQ and echos key back to screen
+ *   SIDE EFFECTS: Signals that interrupt has been handled to KEYBOARD_IRQ and echos key back to screen.
+ *                 runs without the kernel lock, the screen and terminal locks cover what it touches
  */
 void
 keyboard_int_handler()
 {
-    cli();
-
+    terminal_t* term;
+    unsigned char c;
+    int32_t id;
     char key = 0;
 
-    key = get_char();
+    // not a kernel lock hold, so time the interrupts-off window here
+    irq_off_begin();
+    c = get_scan_code();
+
+    // switching takes the screen lock for writing, so before any other lock
+    if((id = switch_term_key(c)) != -1){
+        switch_term(id);
+        send_eoi(KEYBOARD_IRQ);
+        irq_off_end();
+        return;
+    }
+
+    // interrupts are already off in here, the plain locks will do. the
+    // terminal lock keeps terminal_write's cursor out of the way of our echo
+    read_lock(&screen_lock);
+    term = curr_term;
+    spin_lock(&term->lock);
+    key = get_char(c);
+
     // only print a valid character to screen
     if(key != 0){
 
@@ -379,9 +386,12 @@ keyboard_int_handler()
     curr_term->y_loc = get_screen_y();
     update_cursor(get_screen_y(), get_screen_x());
 
+    spin_unlock(&term->lock);
+    read_unlock(&screen_lock);
+
     send_eoi(KEYBOARD_IRQ);  // signal PIC
 
-    sti();
+    irq_off_end();
 }
 
 
@@ -420,6 +430,7 @@ handle_newline(){
 
     putc_mod('\n');
     curr_term->enter_flag = 1;
+    wake_up(&curr_term->read_wait);
 }
 
 /*
@@ -527,43 +538,41 @@ handle_tab(){
  *   SIDE EFFECTS: writes into the passed buffer
  */
 int32_t terminal_read(int32_t fd, void* in_buf, int32_t nbytes) {
-    uint32_t i;
-    int32_t ret = 0;
-    pcb_t * temp;
-    curr_term->enter_flag = 0;
-    char* char_in_buf = (char*) in_buf;
+    uint32_t flags;
+    int32_t i, ret = 0;
+    terminal_t* term;
+    char line[RET_BUF_SIZE];
 
     // if stdout is calling it, call should fail
     if(fd == STDOUT_FD){
         return ERROR;
     }
 
-    temp = scheduler.curr_process;
-
-    sti();
-    while (!(terminals[temp->tid].enter_flag));
-    curr_term->enter_flag = 0;
-
-    while(scheduler.curr_process->pid != temp->pid);
-    cli();
-
-
-    // scheduler.curr_process = temp;
-
-    //add the buf into the in_buf
-    for (i = 0; i < nbytes; i++) {
-        //make sure the index is not out of any bounds
-        if (nbytes >= ret && curr_term->return_buffer[i] != '\n') {
-            char_in_buf[i] = curr_term->return_buffer[i];
-            ret++;
-        } else {
-            if(curr_term->return_buffer[i] == '\n'){
-                char_in_buf[i] = curr_term->return_buffer[i];
-                ret++;
-            }
+    // our own terminal, which need not be the one on screen
+    term = &terminals[this_rq()->curr_process->tid];
+    term_mark_ready(term->tid);
+
+    //the keyboard handler wakes us when enter is pressed on this terminal,
+    //under the terminal lock. we are on the wait queue before it is let go
+    flags = spin_lock_irqsave(&term->lock);
+    term->enter_flag = 0;
+    while (!term->enter_flag) {
+        sleep_on_unlock(&term->read_wait, &term->lock);
+        spin_lock(&term->lock);
+    }
+    term->enter_flag = 0;
+
+    //take the line up to and including its newline. the user's buffer is
+    //only touched once the lock is let go, a fault on it could take a while
+    for (i = 0; i < nbytes && i < RET_BUF_SIZE; i++) {
+        line[i] = term->return_buffer[i];
+        ret++;
+        if (line[i] == '\n')
             break;
-        }
     }
+    spin_unlock_irqrestore(&term->lock, flags);
+
+    memcpy(in_buf, line, ret);
     //return number of bytes read.
     return ret;
 }
@@ -62,7 +62,7 @@ extern void keyboard_init(void);
 /* Reads scan code from keyboard */
 extern char get_scan_code();
 /* Returns the character represented by the scancode */
-extern char get_char();
+extern char get_char(unsigned char c);
 /* Interrupt handler for keyboard */
 extern void keyboard_int_handler();
 /* Delete from buffer and update display */
@@ -310,6 +310,22 @@ scroll_up_page(terminal_t* term)
 	}
 }
 
+/*
+* void clear_page
+*   Inputs: term - backup terminal buffer to "clear()"
+*   Return Value: none
+*	Function: Blanks a backup terminal buffer
+*/
+void
+clear_page(terminal_t* term)
+{
+	int i;
+	for (i = 0; i < NUM_ROWS*NUM_COLS; i++) {
+		term->pte[i << 1] = ' ';
+		term->pte[(i << 1) + 1] = ATTRIB;
+	}
+}
+
 
 /*
 * int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -32,6 +32,7 @@ int32_t puts_mod(int8_t* s);
 void putc_page(uint8_t c, terminal_t* term);
 void scroll_up();
 void scroll_up_page(terminal_t* term);
+void clear_page(terminal_t* term);
 uint32_t strlen_mod(const int8_t* s);
 
 // read and set video memory location
@@ -88,6 +89,29 @@ static inline uint32_t inl(port)
 	return val;
 }
 
+/* Reads the time-stamp counter. Only the low 32 bits are returned, which
+ * is plenty for measuring short intervals as long as callers take deltas */
+static inline uint32_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc"
+			: "=a"(lo), "=d"(hi)
+			:
+			: "memory" );
+	return lo;
+}
+
+/* Reads the whole time-stamp counter, for clocks that must not wrap */
+static inline uint64_t rdtsc64(void)
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc"
+			: "=a"(lo), "=d"(hi)
+			:
+			: "memory" );
+	return ((uint64_t)hi << 32) | lo;
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
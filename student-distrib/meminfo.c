@@ -0,0 +1,120 @@
+/* meminfo.c - Memory accounting per process and for the whole system
+ * vim:ts=4 noexpandtab
+ */
+
+#include "meminfo.h"
+#include "frame_alloc.h"
+#include "paging_init.h"
+#include "user_mem.h"
+#include "shm.h"
+#include "snapshot.h"
+#include "sched.h"
+#include "stats.h"
+#include "lib.h"
+#include "smp.h"
+
+//filled in by meminfo, too big for the kernel stack
+static meminfo_t info;
+
+/*
+ * uint32_t count_user_pages(uint32_t* pg_dir, proc_mem_t* mem)
+ *   DESCRIPTION: walks the user half of a page directory and sorts the
+ *                present pages by region. the vidmap page is not counted,
+ *                it belongs to the terminal
+ *   INPUTS: pg_dir - page directory to walk
+ *           mem - counters to add to, may be NULL
+ *   OUTPUTS: mem
+ *   RETURN VALUE: number of present user pages
+ *   SIDE EFFECTS: none
+ */
+uint32_t count_user_pages(uint32_t* pg_dir, proc_mem_t* mem) {
+	uint32_t pde_idx, i, vaddr, total = 0;
+	uint32_t* table;
+
+	for (pde_idx = KERNEL_PG_DIR_ENTRIES; pde_idx < PG_DIR_TAB_SIZE; pde_idx++) {
+		if ((pg_dir[pde_idx] & PRESENT) == 0 || (pg_dir[pde_idx] & PAGE_SIZE_4MB))
+			continue;
+		if (pde_idx == VIDMAP_PG_DIR_OFFSET) {
+			if (mem != NULL)
+				mem->vidmap = 1;
+			continue;
+		}
+
+		table = (uint32_t*)(pg_dir[pde_idx] & HIGH_20_MASK);
+		if (mem != NULL)
+			mem->page_tables++;
+		for (i = 0; i < PG_DIR_TAB_SIZE; i++) {
+			if ((table[i] & PRESENT) == 0)
+				continue;
+			total++;
+			if (mem == NULL)
+				continue;
+
+			vaddr = (pde_idx * ALIGNED_4MB) + (i * ALIGNED_4KB);
+			if (vaddr < USER_IMAGE_END)
+				mem->image_pages++;
+			else if (vaddr < USER_HEAP_END)
+				mem->heap_pages++;
+			else if (vaddr >= USER_STACK_START)
+				mem->stack_pages++;
+			else
+				mem->shm_pages++;
+			if (frame_refcount(table[i] & HIGH_20_MASK) > 1)
+				mem->shared_pages++;
+		}
+	}
+	return total;
+}
+
+/*
+ * int32_t meminfo(void* buf, int32_t nbytes)
+ *   DESCRIPTION: reports free physical memory, kernel objects, and how many
+ *                pages each process has mapped, so it is visible who holds
+ *                memory when deciding how many processes to run
+ *   INPUTS: buf -- user buffer to copy a meminfo_t into
+ * 			 nbytes -- size of buf, at most sizeof(meminfo_t) bytes are copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes copied, ERROR on failure
+ *   SIDE EFFECTS: writes to buf
+ */
+int32_t meminfo(void* buf, int32_t nbytes) {
+	pcb_t* curr = this_rq()->curr_process;
+	proc_mem_t* mem;
+	pcb_t* pcb;
+	uint32_t pid;
+
+	if (curr == NULL || buf == NULL || nbytes <= 0)
+		return ERROR;
+	if (nbytes > sizeof(meminfo_t))
+		nbytes = sizeof(meminfo_t);
+	if (!user_addr_ok(curr, (uint32_t)buf) ||
+		!user_addr_ok(curr, (uint32_t)buf + nbytes - 1))
+		return ERROR;
+
+	memset(&info, 0, sizeof(meminfo_t));
+	info.total_frames = frames_total();
+	info.free_frames = frames_available();
+	info.zeroed_frames = kstats.zero_pool_depth;
+	shm_usage(&info.shm_segments, &info.shm_pages);
+	snapshot_usage(&info.snapshots, &info.snapshot_pages);
+
+	for (pid = 0; pid < MAX_PROG_NUM; pid++) {
+		mem = &info.procs[pid];
+		if (pid_arr[pid] != PID_USED) {
+			mem->pid = MEMINFO_NO_PID;
+			continue;
+		}
+
+		pcb = get_pcb(pid);
+		info.processes++;
+		mem->pid = pid;
+		mem->parent = (pcb->parent != NULL) ? (int32_t)pcb->parent->pid : MEMINFO_NO_PID;
+		mem->tid = pcb->tid;
+		mem->state = pcb->state;
+		mem->kernel_bytes = ALIGNED_8KB;
+		count_user_pages(pcb->page_dir, mem);
+	}
+
+	memcpy(buf, &info, nbytes);
+	return nbytes;
+}
@@ -0,0 +1,52 @@
+/* meminfo.h - Memory accounting per process and for the whole system
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _MEMINFO_H
+#define _MEMINFO_H
+
+#include "types.h"
+#include "pcb.h"
+
+#define MEMINFO_NO_PID		-1
+
+#define ERROR				-1
+
+/* what one process has mapped, in 4KB pages */
+typedef struct proc_mem_t
+{
+	int32_t pid;			//MEMINFO_NO_PID if the slot is free
+	int32_t parent;			//pid of the parent, MEMINFO_NO_PID for root shells
+	uint32_t tid;
+	uint32_t state;			//see sched.h, zombies have no pages left
+	uint32_t image_pages;	//program image, bss and stack
+	uint32_t heap_pages;
+	uint32_t shm_pages;
+	uint32_t shared_pages;	//pages above whose frame is also mapped elsewhere
+	uint32_t page_tables;	//frames used for the process's own page tables
+	uint32_t vidmap;		//video memory is mapped
+	uint32_t kernel_bytes;	//kernel stack and pcb
+	uint32_t stack_pages;	//user stack, not part of image_pages
+} proc_mem_t;
+
+/* filled in by the meminfo syscall. new fields only ever get appended */
+typedef struct meminfo_t
+{
+	uint32_t total_frames;		//4KB frames in the pool
+	uint32_t free_frames;		//free, including the zero pool
+	uint32_t zeroed_frames;		//of those, already zeroed
+	uint32_t processes;			//processes with a pid, zombies included
+	uint32_t shm_segments;
+	uint32_t shm_pages;			//frames held by the segments themselves
+	uint32_t snapshots;
+	uint32_t snapshot_pages;	//pages the snapshots map, mostly shared
+	proc_mem_t procs[MAX_PROG_NUM];
+} meminfo_t;
+
+/* Counts the user pages of a page directory, filling in mem if not NULL */
+uint32_t count_user_pages(uint32_t* pg_dir, proc_mem_t* mem);
+
+/* System call */
+int32_t meminfo(void* buf, int32_t nbytes);
+
+#endif /* _MEMINFO_H */
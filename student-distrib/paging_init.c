@@ -1,10 +1,23 @@
 #include "paging_init.h"
+#include "stats.h"
+#include "frame_alloc.h"
+#include "systemcalls.h"
+#include "smp.h"
 
 
 uint32_t page_directory[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 uint32_t page_table[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
+uint32_t proc_page_directory[MAX_PROG_NUM][PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 uint32_t term_pte[NUM_TERMS] = {VID_TERM0, VID_TERM1, VID_TERM2};
 
+// the cpu that last loaded each process's page directory, the only one that
+// may trust its tlb matches it. page_directory never changes after boot, so
+// any number of cpus may trust it and it has no owner
+static cpu_t* dir_owner[MAX_PROG_NUM];
+
+static cpu_t** page_directory_owner(uint32_t* pg_dir);
+static void forget_page_directory(uint32_t* pg_dir, cpu_t** owner);
+
 /*
  * intialize_paging
  *   DESCRIPTION: Initializes Paging and creates page directory and page table
@@ -15,6 +28,7 @@ uint32_t term_pte[NUM_TERMS] = {VID_TERM0, VID_TERM1, VID_TERM2};
  */
 void intialize_paging() {
     int i;
+    uint32_t frame_block;
 
     // clear all present bits in page dir and page table
     for(i = 0; i < PG_DIR_TAB_SIZE; ++i) {
@@ -23,14 +37,20 @@ void intialize_paging() {
     }
 
     // set vid mem pg table and kernel entries in page directory
-    page_directory[0] = ((unsigned int) page_table) | PRESENT;
-    page_directory[1] = KERNEL_PG_DIR_ENTRY;
+    page_directory[VID_PG_DIR_OFFSET] = ((unsigned int) page_table) | READ_WRITE | PRESENT;
+    page_directory[KERNEL_PG_DIR_OFFSET] = KERNEL_PG_DIR_ENTRY;
 
-    // set vid mem pg in pg table
-    page_table[VID_MEM   >> LOWER_12_BITS] = VID_MEM   | PRESENT;
-    page_table[VID_TERM0 >> LOWER_12_BITS] = VID_TERM0 | PRESENT;
-    page_table[VID_TERM1 >> LOWER_12_BITS] = VID_TERM1 | PRESENT;
-    page_table[VID_TERM2 >> LOWER_12_BITS] = VID_TERM2 | PRESENT;
+    // identity map the frame pool with 4MB kernel pages so frames handed to
+    // user space can still be zeroed and copied by the kernel
+    for(frame_block = FRAME_POOL_START; frame_block < FRAME_POOL_END; frame_block += ALIGNED_4MB)
+        page_directory[frame_block >> PDE_SHIFT] = frame_block | PAGE_SIZE_4MB | GLOBAL | READ_WRITE | PRESENT;
+
+    // set vid mem pg in pg table. these never change, so they are global
+    // and stay in the tlb when the scheduler reloads cr3
+    page_table[VID_MEM   >> LOWER_12_BITS] = VID_MEM   | GLOBAL | READ_WRITE | PRESENT;
+    page_table[VID_TERM0 >> LOWER_12_BITS] = VID_TERM0 | GLOBAL | READ_WRITE | PRESENT;
+    page_table[VID_TERM1 >> LOWER_12_BITS] = VID_TERM1 | GLOBAL | READ_WRITE | PRESENT;
+    page_table[VID_TERM2 >> LOWER_12_BITS] = VID_TERM2 | GLOBAL | READ_WRITE | PRESENT;
 
 
     // intialize paging
@@ -60,4 +80,146 @@ void intialize_paging() {
         : "r" (page_directory)
         : "eax"
     );
+
+    // enable global pages so kernel tlb entries survive address space switches
+    asm volatile(
+        "movl %%cr4, %%eax;"
+        "orl  %0, %%eax;"
+        "movl %%eax, %%cr4;"
+        :
+        : "i" (CR4_PGE)
+        : "eax"
+    );
+
+    // make read only pages read only for the kernel too, so a write to a
+    // copy on write page from inside a system call faults like a user write
+    asm volatile(
+        "movl %%cr0, %%eax;"
+        "orl  %0, %%eax;"
+        "movl %%eax, %%cr0;"
+        :
+        : "i" (CR0_WP)
+        : "eax"
+    );
+}
+
+/*
+ * init_proc_page_directory
+ *   DESCRIPTION: Sets up the page directory owned by a process. The kernel
+ *                entries point at the same page table and 4MB page as the
+ *                boot page directory, everything else starts out not present.
+ *   INPUTS: pid - the process the page directory belongs to
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the page directory, NULL if pid is out of range
+ *   SIDE EFFECTS: Overwrites every entry in the process's page directory,
+ *                 no cpu may keep using the old ones lazily
+ */
+uint32_t* init_proc_page_directory(uint32_t pid) {
+    int i;
+    uint32_t* pg_dir;
+
+    if(pid >= MAX_PROG_NUM)
+        return NULL;
+
+    pg_dir = proc_page_directory[pid];
+    forget_page_directory(pg_dir, page_directory_owner(pg_dir));
+
+    // kernel mappings are shared, so they never have to be patched per process.
+    // an idle cpu may still run on this directory (see context_switch), so
+    // they are rewritten with the same values, never cleared
+    for(i = 0; i < PG_DIR_TAB_SIZE; ++i)
+        pg_dir[i] = (i < KERNEL_PG_DIR_ENTRIES) ? page_directory[i] : 0;
+
+    return pg_dir;
+}
+
+/*
+ * page_directory_owner
+ *   DESCRIPTION: Finds where the owner of pg_dir is kept
+ *   INPUTS: pg_dir - one of proc_page_directory
+ *   OUTPUTS: none
+ *   RETURN VALUE: the owner's slot in dir_owner, NULL for any other pointer
+ *   SIDE EFFECTS: none
+ */
+static cpu_t** page_directory_owner(uint32_t* pg_dir) {
+    uint32_t pid;
+
+    pid = ((uint32_t)pg_dir - (uint32_t)proc_page_directory) / sizeof(proc_page_directory[0]);
+    if(pid >= MAX_PROG_NUM || pg_dir != proc_page_directory[pid])
+        return NULL;
+    return &dir_owner[pid];
+}
+
+/*
+ * forget_page_directory
+ *   DESCRIPTION: Stops the cpu that last loaded pg_dir from trusting that its
+ *                tlb still matches it, so its next switch to pg_dir loads cr3
+ *                again. Only the owner can trust pg_dir, so no other cpu needs
+ *                looking at. Runs under the kernel lock like every other user
+ *                of cpu_t.mm_dir
+ *   INPUTS: pg_dir - page directory whose mappings change or move elsewhere
+ *           owner - its slot from page_directory_owner
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the owner of pg_dir and its mm_dir
+ */
+static void forget_page_directory(uint32_t* pg_dir, cpu_t** owner) {
+    if(owner == NULL || *owner == NULL)
+        return;
+    if((*owner)->mm_dir == pg_dir)
+        (*owner)->mm_dir = NULL;
+    *owner = NULL;
+}
+
+/*
+ * load_page_directory
+ *   DESCRIPTION: Makes pg_dir the active address space
+ *   INPUTS: pg_dir - page directory to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Writes cr3, which also flushes the tlb. This cpu becomes
+ *                 the owner of pg_dir, the only one whose tlb is known to
+ *                 match it
+ */
+void load_page_directory(uint32_t* pg_dir) {
+    cpu_t* cpu;
+    cpu_t** owner;
+
+    if(pg_dir == NULL)
+        return;
+
+    asm volatile(
+        "movl %0, %%cr3;"
+        :
+        : "r" (pg_dir)
+        : "memory"
+    );
+    kstats.tlb_full_flushes++;
+
+    // whoever runs on pg_dir now may change its mappings and only flush here
+    cpu = this_cpu();
+    owner = page_directory_owner(pg_dir);
+    forget_page_directory(pg_dir, owner);
+    cpu->mm_dir = pg_dir;
+    if(owner != NULL)
+        *owner = cpu;
+}
+
+/*
+ * flush_tlb_page
+ *   DESCRIPTION: Invalidates the tlb entry that maps vaddr. Use this instead of
+ *                reloading cr3 whenever only a single pte or pde changed.
+ *   INPUTS: vaddr - virtual address whose mapping changed
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Executes invlpg
+ */
+void flush_tlb_page(uint32_t vaddr) {
+    asm volatile(
+        "invlpg (%0);"
+        :
+        : "r" (vaddr)
+        : "memory"
+    );
+    kstats.tlb_page_flushes++;
 }
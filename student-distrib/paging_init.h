@@ -4,6 +4,7 @@
 
 #include "types.h"
 #include "terminal.h"
+#include "pcb.h"
 
 #define ALIGNED_4KB     0x1000
 #define HIGH_20_MASK    0xFFFFF000
@@ -11,21 +12,43 @@
 #define PRESENT         0x1
 #define READ_WRITE      0x2
 #define USER_SUPERVISOR 0x4
+#define WRITE_THROUGH   0x8
+#define CACHE_DISABLE   0x10
 #define PAGE_SIZE_4MB   0x80
+#define GLOBAL          0x100
+#define PTE_COW         0x200
+#define PTE_SHARED      0x400
+#define CR4_PGE         0x80
+#define CR0_WP          0x10000
 #define PG_DIR_TAB_SIZE 1024
 
-#define KERNEL_PG_DIR_ENTRY (0x00400000 | PAGE_SIZE_4MB | PRESENT)
+#define KERNEL_PG_DIR_ENTRY (0x00400000 | PAGE_SIZE_4MB | GLOBAL | READ_WRITE | PRESENT)
 #define VID_MEM             0xB8000
 #define VID_TERM0           0xB9000
 #define VID_TERM1           0xBA000
 #define VID_TERM2           0xBB000
 
 #define LOWER_12_BITS       12
+#define PDE_SHIFT           22
+#define PTE_INDEX_MASK      0x3FF
+
+// page directory entries that every address space shares with the kernel.
+// everything below 64MB belongs to the kernel (see frame_alloc.h)
+#define VID_PG_DIR_OFFSET       0
+#define KERNEL_PG_DIR_OFFSET    1
+#define KERNEL_PG_DIR_ENTRIES   16
 
 
 void intialize_paging();
+/* Builds a fresh page directory for pid with only the kernel mappings present */
+uint32_t* init_proc_page_directory(uint32_t pid);
+/* Switches address spaces by loading a page directory into cr3 */
+void load_page_directory(uint32_t* pg_dir);
+/* Drops the tlb entry for a single virtual address */
+void flush_tlb_page(uint32_t vaddr);
 
 extern uint32_t page_directory[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
+extern uint32_t proc_page_directory[MAX_PROG_NUM][PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 extern uint32_t page_table[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 extern uint32_t term_pte[NUM_TERMS];
 
@@ -2,6 +2,8 @@
 #include "pcb.h"
 #include "terminal.h"
 #include "sched.h"
+#include "systemcalls.h"
+#include "smp.h"
 
 int32_t curr_term_idx;
 pcb_t* pcb_term[NUM_TERMS];
@@ -82,14 +84,20 @@ int32_t free_pid(uint32_t pid) {
 }
 
 /*
- * uint32_t init_pcb(pcb_t * it)
- *   DESCRIPTION: initializes a given PCB.
+ * uint32_t init_pcb(pcb_t * it, pcb_t * parent, uint32_t tid, uint32_t foreground)
+ *   DESCRIPTION: initializes a given PCB and puts it on the runqueue.
  *   INPUTS: it - this is a pointer to a pcb
+ *           parent - the process that created it, NULL for the shell at
+ *                    the base of a terminal
+ *           tid - terminal the new process belongs to
+ *           foreground - 1 if it takes over the terminal and the cpu right
+ *                        away while the parent sleeps (execute), 0 if the
+ *                        parent keeps running (spawn)
  *   OUTPUTS: it
  *   RETURN VALUE: -1 if full or error : 0 on success
- *   SIDE EFFECTS: modifies it.
+ *   SIDE EFFECTS: modifies it and the runqueue
  */
-int32_t init_pcb(pcb_t* it) {
+int32_t init_pcb(pcb_t* it, pcb_t* parent, uint32_t tid, uint32_t foreground) {
 	uint32_t i;
 	int fd;
 	if (it == NULL) return ERROR;
@@ -105,11 +113,6 @@ int32_t init_pcb(pcb_t* it) {
 	it->file_desc_array[STDIN_FD] = fd_std;
 	it->file_desc_array[STDOUT_FD] = fd_std;
 
-	//initialize args to empty string
-	for(i = 0; i < BUF_SIZE; ++i) {
-		it->args[i] = '\0';
-	}
-
 	// init all other file descriptors to not in use
 	for(fd = 2; fd < FD_ARRAY_MAX; fd++){
 		file_desc_t fd_unused;
@@ -117,23 +120,43 @@ int32_t init_pcb(pcb_t* it) {
 		it->file_desc_array[fd] = fd_unused;
 	}
 
+	// no shared memory attached yet
+	for(i = 0; i < MAX_SHM_ATTACH; i++) {
+		it->shm[i].id = SHM_SLOT_FREE;
+		it->shm[i].addr = 0;
+	}
+
 	//update current pcb
 	num_processes++;
 	// Start at the bottom of the 8KB block
 	it->curr_esp = (uint32_t)it + ALIGNED_8KB - 4;
-	it->curr_ebp = (uint32_t)it + ALIGNED_8KB - 4;
 
-	curr_term_idx = curr_term->tid;
-	it->tid = curr_term_idx;
-	it->parent = pcb_term[curr_term_idx];
-	pcb_term[curr_term_idx] = it;
+	it->tid = tid;
+	it->parent = parent;
+	it->first_run = 0;
+	wait_queue_init(&it->child_wait);
+	it->wait_next = NULL;
+	it->priority = 0;
+	it->slice_left = MLFQ_SLICE(0);
+	it->on_rq = 0;
+	it->cpu = smp_cpu_id();
+	it->lock_depth = 0;
+	it->exit_status = 0;
 
 
 	//update capacity
 	it->capacity = 2;
 
 	//update scheduler
-	add_process_to_runqueue(&scheduler, it);
+	if (foreground) {
+		it->parent_waiting = (parent != NULL);
+		pcb_term[tid] = it;
+		add_process_to_runqueue(this_rq(), it);
+	} else {
+		it->parent_waiting = 0;
+		it->state = TASK_RUNNING;
+		sched_place(it);
+	}
 
 	return 0;
 }
@@ -160,3 +183,44 @@ int32_t find_open_idx(pcb_t* pcb) {
 	}
 	return ERROR;
 }
+
+/*
+ * pcb_t* get_pcb(uint32_t pid)
+ *   DESCRIPTION: finds the pcb of pid at the bottom of its kernel stack
+ *   INPUTS: pid - a pid
+ *   OUTPUTS: none
+ *   RETURN VALUE: the pcb, NULL if pid is out of range
+ *   SIDE EFFECTS: none
+ */
+pcb_t* get_pcb(uint32_t pid) {
+	if (pid >= MAX_PROG_NUM)
+		return NULL;
+	return (pcb_t*)(ALIGNED_8MB - ((pid + 1) * ALIGNED_8KB));
+}
+
+/*
+ * void orphan_children(pcb_t* pcb)
+ *   DESCRIPTION: forgets pcb as the parent of every process it forked or
+ *                spawned, so nothing points at it once its pid is reused.
+ *                children that already halted have nobody left to collect
+ *                their status, so their pids are freed right away
+ *   INPUTS: pcb - a process that is halting
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the parent of pcb's children, may free pids
+ */
+void orphan_children(pcb_t* pcb) {
+	uint32_t i;
+	pcb_t* child;
+
+	for (i = 0; i < MAX_PROG_NUM; i++) {
+		if (pid_arr[i] == PID_AVAILABLE)
+			continue;
+		child = get_pcb(i);
+		if (child == pcb || child->parent != pcb)
+			continue;
+		child->parent = NULL;
+		if (child->state == TASK_ZOMBIE)
+			free_pid(i);
+	}
+}
@@ -19,8 +19,13 @@
 #define PID_AVAILABLE		0
 #define PID_USED			1
 
+#define WAIT_ANY			-1
+
 #define ALIGNED_8KB 		0x2000
 
+#define MAX_SHM_ATTACH		4
+#define SHM_SLOT_FREE		-1
+
 #define ERROR				-1
 
 uint32_t num_processes;
@@ -42,6 +47,13 @@ typedef struct file_desc_t
 	uint32_t flags; //needs to indicate "in-use", ....
 } file_desc_t;
 
+/* a shared memory segment a process has open (see shm.h) */
+typedef struct shm_attach_t
+{
+	int32_t id;		//segment id, SHM_SLOT_FREE if the slot is unused
+	uint32_t addr;	//user address it is mapped at, 0 if only opened
+} shm_attach_t;
+
 /* general struct for a PCB */
 typedef struct pcb_t {
 	uint32_t tid;			//terminal id [0,2]
@@ -49,13 +61,30 @@ typedef struct pcb_t {
 	uint32_t capacity;		//amount of files currently in array
 	uint32_t esp;			//parent's esp to return to in halt
 	uint32_t ebp;			//parent's ebp to return to in halt
-	uint32_t curr_esp;		//current process's esp to return to when context switching
-	uint32_t curr_ebp;		//current process's ebp to return to when context switching
+	uint32_t curr_esp;		//kernel esp saved by switch_to, a switch_frame_t sits there
 	struct pcb_t* parent;	//pointer to parent pcb
-	char args[BUF_SIZE];	//stores arguments as array of chars
+	uint32_t parent_waiting;	//parent is blocked in execute until this process halts
+	uint32_t first_run;		//forked and not scheduled yet, starts in ret_from_fork
+	wait_queue_t child_wait;	//waitpid sleeps here until a child halts
+	int32_t exit_status;	//status passed to halt, kept until the parent collects it
+	uint32_t* page_dir;		//this process's page directory, loaded into cr3 on a switch
+	uint32_t heap_start;	//first address of the demand paged heap
+	uint32_t brk;			//current end of the heap, see brk/sbrk
+	shm_attach_t shm[MAX_SHM_ATTACH];	//shared memory segments this process has open
+	uint32_t argc;			//number of strings in argv
+	uint32_t argv;			//user address of the argv array on the user stack
+	uint32_t envp;			//user address of the envp array, inherited by children
+	int8_t filename[MAX_STRING_LEN];	//program file it runs, NUL padded like a dentry name
 	file_desc_t file_desc_array[FD_ARRAY_MAX];	// array of file descriptors
 	struct pcb_t * next;	//next pcb for the scheduler
 	struct pcb_t * prev;	//previous pcb for the scheduler
+	struct pcb_t * wait_next;	//next sleeper on the same wait queue or timer list
+	uint64_t wake_us;		//clock_us to wake at, while in timer_sleep
+	uint32_t priority;		//mlfq level, 0 runs first (see sched.h)
+	uint32_t slice_left;	//ticks left in its quantum at that level
+	uint32_t on_rq;			//queued on the scheduler's run queue
+	uint32_t cpu;			//cpu whose run queue it belongs to
+	uint32_t lock_depth;	//kernel lock nesting while switched out
 	uint32_t state;			//task is excecuting currently or waiting to execute
 							//one of {TASK_RUNNING, TASK_SLEEPING,
 							//		  TASK_INTERRUPTIBLE, TASK_UNINTERRUPTIBLE,
@@ -72,7 +101,11 @@ int32_t set_pid(uint32_t pid);
 
 int32_t free_pid(uint32_t pid);
 
-int32_t init_pcb(pcb_t* it);
+int32_t init_pcb(pcb_t* it, pcb_t* parent, uint32_t tid, uint32_t foreground);
+
+pcb_t* get_pcb(uint32_t pid);
+
+void orphan_children(pcb_t* pcb);
 
 int32_t find_open_idx(pcb_t* pcb);
 
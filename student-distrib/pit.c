@@ -10,6 +10,13 @@
 #include "pit.h"
 #include "lib.h"
 #include "terminal.h"
+#include "stats.h"
+#include "timer.h"
+#include "smp.h"
+
+/* the PIT ticks periodically from boot until timer_init takes over. it
+ * then either is the one shot timer, when there is no local APIC, or just
+ * times the calibration of the faster clocks (see timer.c) */
 
 /*
  * void pit_init
@@ -37,6 +44,57 @@ pit_init(void)
 }
 
 
+/*
+ * void pit_arm
+ *   DESCRIPTION: sets channel 0 to a one shot, replacing whatever it was
+ *                counting. anything past the counter's reach is clamped to
+ *                ONE_SHOT_MAX_US, the caller's clock tells it how late it is
+ *   INPUTS: us - microseconds until the interrupt
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reprograms the PIT
+ */
+void
+pit_arm(uint32_t us)
+{
+    uint32_t count;
+
+    if (us > ONE_SHOT_MAX_US)
+        us = ONE_SHOT_MAX_US;
+    count = us * (CLOCK_TICK_RATE / 1000) / 1000;
+    if (count == 0)
+        count = 1;
+
+    outb(ONE_SHOT_MODE, COMMAND_REG);
+    outb(count & 0xFF, CHANNEL_0_PORT);
+    outb(count >> 8, CHANNEL_0_PORT);
+}
+
+
+/*
+ * void pit_delay
+ *   DESCRIPTION: busy waits on channel 2, which has no interrupt and
+ *                leaves channel 0 alone. used to calibrate other clocks
+ *   INPUTS: clocks - PIT input clocks to wait, at most ONE_SHOT_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reprograms channel 2, keeps the speaker off
+ */
+void
+pit_delay(uint32_t clocks)
+{
+    outb((inb(PIT_CH2_CTRL) & ~PIT_SPEAKER) | PIT_CH2_GATE, PIT_CH2_CTRL);
+
+    //counting starts once the count is loaded, out goes high at zero
+    outb(CH2_ONE_SHOT, COMMAND_REG);
+    outb(clocks & 0xFF, CHANNEL_2_PORT);
+    outb(clocks >> 8, CHANNEL_2_PORT);
+
+    while (!(inb(PIT_CH2_CTRL) & PIT_CH2_OUT))
+        ;
+}
+
+
 /*
  * void pit_int_handler
  *   DESCRIPTION: Handles PIT interrupts
@@ -49,91 +107,11 @@ pit_init(void)
 void
 pit_int_handler()
 {
-    cli();
-
-    // if(terminals[1].active == INACTIVE) {
-    //     switch_term(1);
-    //     curr_term->active = ACTIVE;
-    //     send_eoi(PIT_IRQ);
-    //     // asm volatile (
-    //     //     "popfl;"
-    //     //     "popal;"
-    //     //     :
-    //     //     :
-    //     // );
-    //     execute((const uint8_t*)"shell");
-    // }
-    // if(terminals[0].active == INACTIVE) {
-    //     switch_term(0);
-    //     curr_term->active = ACTIVE;
-    //     send_eoi(PIT_IRQ);
-    //     // asm volatile (
-    //     //     "popfl;"
-    //     //     "popal;"
-    //     //     :
-    //     //     :
-    //     // );
-    //     execute((const uint8_t*)"shell");
-    // }
-
-
-    //upnext is the next process to run
-    pcb_t * up_next;
-    //current is the current process running
-    pcb_t * current;
-
-    //handle if scheduler is empty.  nothing to schedule
-    if (scheduler.head == NULL || scheduler.tail == NULL) return;
-
-    //geth the current process temporarily.
-    if (scheduler.curr_process != NULL) {
-        current = scheduler.curr_process;
-    } else {
-        return;
-    }
-
-    //rotate the queue
-    if (runqueue_rotate() == ERROR) return;
-
-    //rotate the queue until we find a process that is running
-    while (scheduler.head->state != TASK_RUNNING) {
-        runqueue_rotate();
-    }
-
-    //update the current process and store it temporarily.
-    up_next = scheduler.head;
-    scheduler.curr_process = up_next;
-    //prepare for context switch
-    page_directory[EXEC_PG_DIR_OFFSET] = (ALIGNED_8MB + ALIGNED_4MB * up_next->pid) | EXEC_PG_DIR_FLAGS;
-
-    if(up_next->tid == curr_term_idx)
-        vidmap_page_table_array[current->tid][0] = (uint32_t)(terminals[current->tid].pte) | READ_WRITE | USER_SUPERVISOR | PRESENT;
-    else
-        vidmap_page_table_array[up_next->tid][0] = (uint32_t)(terminals[up_next->tid].pte) | READ_WRITE | USER_SUPERVISOR | PRESENT;
-
-    page_directory[VIDMAP_PG_DIR_OFFSET] = (uint32_t)(vidmap_page_table_array[up_next->tid]) | USER_SUPERVISOR | READ_WRITE | PRESENT;
-    vidmap_page_table_array[curr_term_idx][0] = VID_MEM | READ_WRITE | USER_SUPERVISOR | PRESENT;
-
-    flush_tlb();
-    //switch the stack
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = ALIGNED_8MB - (up_next->pid * ALIGNED_8KB) - ALIGNED_4B;
-    //store the Stack registers for the old process
-    asm volatile (
-        "movl %%esp, %0;"
-        "movl %%ebp, %1;"
-        : "=m" (current->curr_esp), "=m" (current->curr_ebp)
-        :
-    );
-    //load the stack registers for the new process.
-    asm volatile (
-        "movl %0, %%esp;"
-        "movl %1, %%ebp;"
-        :
-        : "m" (up_next->curr_esp), "m" (up_next->curr_ebp)
-    );
-
-    //send the interupt end signal
-    send_eoi(PIT_IRQ);  // signal PIC
-    sti();
+    lock_kernel();
+
+    //signal the PIC before switching. a freshly forked process never comes
+    //back here, it leaves for user space straight from context_switch
+    send_eoi(PIT_IRQ);
+    timer_interrupt();
+    unlock_kernel();
 }
@@ -1,6 +1,8 @@
 #ifndef _PIT_H
 #define _PIT_H
 
+#include "types.h"
+
 #define PIT_IRQ				0
 
 
@@ -11,6 +13,16 @@
 #define COMMAND_REG		0x43
 
 #define RATE_GEN_MODE	0x34
+#define ONE_SHOT_MODE	0x30	//mode 0, one interrupt when the count runs out
+#define ONE_SHOT_MAX	0xFFFF	//longest one shot the counter can time, ~55ms
+#define ONE_SHOT_MAX_US	54925	//the same in microseconds
+#define CH2_ONE_SHOT	0xB0	//channel 2 in mode 0, used for busy waits
+
+/* port 0x61 gates channel 2 and shows its output */
+#define PIT_CH2_CTRL	0x61
+#define PIT_CH2_GATE	0x01
+#define PIT_SPEAKER		0x02
+#define PIT_CH2_OUT		0x20
 
 #define HZ				50
 #define CLOCK_TICK_RATE	1193182
@@ -23,5 +35,11 @@ extern void pit_init(void);
 
 extern void pit_int_handler();
 
+/* Sets channel 0 to interrupt once, us microseconds from now */
+extern void pit_arm(uint32_t us);
+
+/* Busy waits for clocks PIT input clocks on channel 2 */
+extern void pit_delay(uint32_t clocks);
+
 
 #endif /* _PIT_H */
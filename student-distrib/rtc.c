@@ -6,6 +6,16 @@
 #include "rtc.h"
 #include "lib.h"
 #include "sched.h"
+#include "frame_alloc.h"
+#include "smp.h"
+#include "spinlock.h"
+
+/* guards the index/data port pairs, read_flag and rtc_count */
+static spinlock_t rtc_lock = SPINLOCK_INIT("rtc", LOCK_RANK_RTC);
+/* counts every interrupt, so waiting on it doesn't disturb read_flag */
+static volatile uint32_t rtc_count;
+/* processes waiting for the next interrupt */
+static wait_queue_t rtc_wait;
 
 /*
  * void rtc_init
@@ -24,6 +34,7 @@ rtc_init(void)
     outb(STATUS_REG_B, RTC_ADDR_PORT);
     char prev = inb(RTC_DATA_PORT); // save value of this reg
     read_flag = 0;
+    wait_queue_init(&rtc_wait);
     outb(STATUS_REG_B, RTC_ADDR_PORT);  // reading reset the index
     outb(prev | 0x40, RTC_DATA_PORT);   // sets bit 6 in reg B
 
@@ -52,17 +63,19 @@ rtc_init(void)
 void
 set_interrupt_rate(unsigned char rate)
 {
+    uint32_t flags;
 
     // check to see if frequency will be between 2 and 1024 Hz (6 <= rate <= 15)
     if(rate < 6 || rate > 15)
         return;
 
-    cli();
+    // a plain sti here used to turn interrupts on in the middle of rtc_write
+    flags = spin_lock_irqsave(&rtc_lock);
     outb(STATUS_REG_A, RTC_ADDR_PORT);               // set index to register A, disable NMI
     char prev = inb(RTC_DATA_PORT);                  // get initial value of register A
     outb(STATUS_REG_A, RTC_ADDR_PORT);               // reset index to A
     outb((prev & 0xF0) | rate, RTC_DATA_PORT);   // write only our rate to A. Note, rate is the bottom 4 bits.
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
 }
 
 
@@ -77,13 +90,33 @@ set_interrupt_rate(unsigned char rate)
  *
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-    read_flag = 0;  //initialize read flag
-    sti();
-    while (!read_flag); //wait for handler to change read flag
-    cli();
+    rtc_wait_tick();
     return 0;   //always return 0
 }
 
+/*
+ * void rtc_wait_tick
+ *   DESCRIPTION: sleeps until the next RTC interrupt at whatever rate was
+ *                last set
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: other processes run meanwhile, must be called with
+ *                 interrupts off
+ */
+void rtc_wait_tick(void) {
+    uint32_t start, flags;
+
+    // the handler counts and wakes under rtc_lock, on any cpu
+    flags = spin_lock_irqsave(&rtc_lock);
+    start = rtc_count;
+    while (rtc_count == start) {
+        sleep_on_unlock(&rtc_wait, &rtc_lock);
+        spin_lock(&rtc_lock);
+    }
+    spin_unlock_irqrestore(&rtc_lock, flags);
+}
+
 /*
  * int32_t rtc_write
  *   DESCRIPTION: writes new value to interrupt rate.
@@ -143,7 +176,10 @@ int32_t rtc_open(const uint8_t* filename) {
  *
  */
 int32_t rtc_close(int32_t fd) {
+    uint32_t flags = spin_lock_irqsave(&rtc_lock);
+
     read_flag = 0;
+    spin_unlock_irqrestore(&rtc_lock, flags);
     return 0;
 }
 
@@ -154,22 +190,30 @@ int32_t rtc_close(int32_t fd) {
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Signals that interrupt has been handled to RTC_IRQ
+ *   SIDE EFFECTS: Signals that interrupt has been handled to RTC_IRQ.
+ *                 runs without the kernel lock, rtc_lock and the wait
+ *                 queue's own lock cover everything it touches
  *
  * Inspiration drawn from: http://wiki.osdev.org/RTC
  */
 void
 rtc_int_handler()
 {
-    cli();
+    // not a kernel lock hold, so time the interrupts-off window here
+    irq_off_begin();
+    spin_lock(&rtc_lock);
     // make sure to read from reg C so that we can receive a new interrupt
     outb(STATUS_REG_C, RTC_ADDR_PORT);   // select register C
     inb(RTC_DATA_PORT);      // just throw away contents
     // test_interrupts();
     // Set the read_flag to enabled
     read_flag = 1;
+    rtc_count++;
+    // still under rtc_lock, so rtc_wait_tick is either asleep or sees the count
+    wake_up(&rtc_wait);
+    spin_unlock(&rtc_lock);
     send_eoi(RTC_IRQ);  // signal PIC
-    sti();
+    irq_off_end();
 }
 
 
@@ -6,6 +6,7 @@
 #define _RTC_H
 
 #include "types.h"
+#include "wait_queue.h"
 
 /* RTCS Ports */
 #define RTC_ADDR_PORT	0x70
@@ -35,6 +36,8 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 	
 // set high whenever interrupt occurs
 volatile int read_flag;
+/* Waits for the next RTC interrupt with interrupts on */
+void rtc_wait_tick(void);
 
 void test_rtc_rw();
 
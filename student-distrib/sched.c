@@ -3,195 +3,784 @@
 #include "pcb.h"
 #include "systemcalls.h"
 #include "paging_init.h"
+#include "stats.h"
+#include "lib.h"
+#include "frame_alloc.h"
+#include "timer.h"
+#include "smp.h"
+
+//tsc value when the current switch started. this cannot be a local since
+//the switch changes stacks halfway through context_switch. switches only
+//happen under the kernel lock, so one is enough for every cpu
+static uint32_t switch_start;
+
+static void idle_loop();
+static void boost_all();
+static void switch_account();
+static uint32_t rq_load(runqueue_t * rq);
+static pcb_t * migrate_task(runqueue_t * from, runqueue_t * to);
+static int32_t steal_task(runqueue_t * rq);
+static void balance(runqueue_t * rq);
+static void kick_idle_cpu(runqueue_t * rq);
+static void double_rq_lock(runqueue_t * held, runqueue_t * other);
 
 
 /*
  * void sched_init()
- *   DESCRIPTION: initializes the scheduler
+ *   DESCRIPTION: initializes the scheduler, an empty run queue per cpu
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: initializes the scheduler
  */
 void sched_init() {
-	scheduler.size = 0;
-	scheduler.max_size = MAX_PROG_NUM;
-	scheduler.curr_process = NULL;
-	scheduler.head = NULL;
-	scheduler.tail = NULL;
+	runqueue_t * rq;
+	uint32_t cpu, level;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		rq = &cpus[cpu].rq;
+		rq->cpu = cpu;
+		spin_lock_init(&rq->lock, "runqueue", LOCK_RANK_RQ);
+		rq->size = 0;
+		rq->bitmap = 0;
+		rq->curr_process = NULL;
+		for (level = 0; level < MLFQ_LEVELS; level++) {
+			rq->head[level] = NULL;
+			rq->tail[level] = NULL;
+		}
+		rq->need_resched = 0;
+		rq->boost_ticks = 0;
+		rq->balance_ticks = 0;
+		rq->idle = NULL;
+	}
+}
+
+
+/*
+ * void sched_start()
+ *   DESCRIPTION: sets up this cpu's idle task and turns the caller into
+ *                it. the boot stack overlaps pid 0's kernel stack, so we
+ *                move to the idle task's own stack first
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none, does not return
+ *   SIDE EFFECTS: makes the idle task current, drops the kernel lock the
+ *                 caller holds and enables interrupts
+ */
+void sched_start() {
+	runqueue_t * rq = this_rq();
+	pcb_t * idle = (pcb_t *)(ALIGNED_8MB - (IDLE_PID(rq->cpu) + 1) * ALIGNED_8KB);
+
+	memset(idle, 0, sizeof(pcb_t));
+	idle->pid = IDLE_PID(rq->cpu);
+	idle->page_dir = page_directory;	//kernel mappings only
+	idle->state = TASK_RUNNING;
+	idle->cpu = rq->cpu;
+	rq->idle = idle;
+	rq->curr_process = idle;
+	unlock_kernel();
+
+	asm volatile (
+		"movl %0, %%esp;"
+		"movl %0, %%ebp;"
+		"jmp *%1;"
+		:
+		: "r" (KERNEL_STACK_TOP(IDLE_PID(rq->cpu))), "r" (idle_loop)
+	);
+}
+
+
+/*
+ * void idle_loop()
+ *   DESCRIPTION: the idle task. runs the next runnable process whenever
+ *                there is one, and otherwise zeroes frames for the pool,
+ *                halting once it is full. any interrupt that wakes a
+ *                process, or an IPI from the cpu that queued one here,
+ *                brings us out of hlt and straight to it. the kernel lock
+ *                is only held while looking, never while zeroing or halted
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none, does not return
+ *   SIDE EFFECTS: switches processes
+ */
+static void idle_loop() {
+	runqueue_t * rq;
+	pcb_t * next;
+	uint32_t flags;
+
+	for (;;) {
+		//wait for another cpu's system call with interrupts on, a wake up
+		//that nests before they go off only queues its process
+		lock_kernel();
+		flags = irq_save();
+		rq = this_rq();
+		if ((next = pick_next_task()) != rq->idle) {
+			context_switch(rq->idle, next);
+			unlock_kernel();
+			irq_restore(flags);
+			continue;
+		}
+
+		//the process whose address space idle stayed in went on to run
+		//elsewhere and may free its page tables, leave them alone
+		if (this_cpu()->mm_dir == NULL)
+			load_page_directory(page_directory);
+		unlock_kernel();
+		irq_restore(flags);
+
+		//zeroing a frame is the one slow thing done here, so it runs with
+		//interrupts on and only the frame allocator's own lock
+		if (zero_pool_refill())
+			continue;
+
+		//sti only takes effect after the next instruction, so a wake up
+		//can't slip in between the check and the hlt
+		cli();
+		if (rq->size == 0)
+			asm volatile ("sti; hlt");
+		sti();
+	}
 }
 
 
 /*
  * uint32_t add_process_to_runqueue()
- *   DESCRIPTION: adds a process to the run queue
+ *   DESCRIPTION: hands the cpu straight to a foreground process started by
+ *                execute. it runs right away instead of waiting in the
+ *                queue, and a parent that waits on it goes to sleep until
+ *                it halts
  *   INPUTS: rq - a run queue to change
- 			 new_p - the new process to add
+ 			 new_p - the new process to run
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success, ERROR - failure
- *   SIDE EFFECTS: changes the runqueue
+ *   SIDE EFFECTS: makes new_p the current process
  */
 int32_t add_process_to_runqueue(runqueue_t * rq, pcb_t * new_p) {
+	uint32_t flags;
+
 	//make sure the new_p is valid
 	if (new_p == NULL || rq == NULL) return ERROR;
-	//make sure a process can be added
-	if (rq->size == rq->max_size) return ERROR;
-	//if new process has a parent, then put the parent to sleep
-	if (new_p->parent != NULL) {
+	//if new process has a parent waiting on it, then put the parent to sleep.
+	//it is the current process, so it is not queued
+	if (new_p->parent != NULL && new_p->parent_waiting) {
 		new_p->parent->state = TASK_SLEEPING;
 	}
-	//push, and update.
-	push(rq, new_p);
 	new_p->state = TASK_RUNNING;
+	new_p->cpu = rq->cpu;
+	flags = spin_lock_irqsave(&rq->lock);
 	rq->curr_process = new_p;
+	spin_unlock_irqrestore(&rq->lock, flags);
 	return 0;
 }
 
 
 /*
  * uint32_t remove_process_from_runqueue()
- *   DESCRIPTION: removes a process from the run queue
+ *   DESCRIPTION: takes a halting process away from the scheduler for good.
+ *                a parent blocked in execute on it becomes the current
+ *                process again, since halt returns straight to it
  *   INPUTS: rq - a run queue to change
- 			 new_p - the process to remove
+ 			 old_p - the process to remove
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success, ERROR - failure
- *   SIDE EFFECTS: changes the runqueue
+ *   SIDE EFFECTS: changes the runqueue, marks old_p TASK_ZOMBIE
  */
 int32_t remove_process_from_runqueue(runqueue_t * rq, pcb_t * old_p) {
+	uint32_t flags;
+	int32_t resume;
+
 	//check for NULL
 	if (rq == NULL || old_p == NULL) return ERROR;
-	//check if head is NUll
-	if(rq->head == NULL){
-		return ERROR;
-	}
-
-	//make old_p a temp variable
-	pcb_t * current = old_p;
 
-	//examine each case and remove the pcb respectively
-	if (current->next == NULL && current->prev == NULL) {
-		rq->head = NULL;
-		rq->tail = NULL;
-	} else if (current->next == NULL && current->prev != NULL) {
-		current->prev->next = NULL;
-		rq->tail = current->prev;
-	} else if (current->next != NULL && current->prev == NULL) {
-		current->next->prev = NULL;
-		rq->head = current->next;
-	} else {
-		current->next->prev = current->prev;
-		current->prev->next = current->next;
-	}
-
-	//decrement the old state and make old_p a Zombie
+	flags = spin_lock_irqsave(&rq->lock);
+	//a running process is not queued, but be safe about it
+	if (old_p->on_rq)
+		dequeue_task(rq, old_p);
 	old_p->state = TASK_ZOMBIE;
-	rq->size -= 1;
 
-	//if old_p's parent is not null, make it the curr_process
-	if (old_p->parent != NULL){
-		old_p->parent->state = TASK_RUNNING;
+	//if old_p's parent is waiting on it, make it the curr_process. halt
+	//returns to it on this cpu, wherever it went to sleep
+	resume = old_p->parent != NULL && old_p->parent_waiting;
+	if (resume) {
+		old_p->parent->cpu = rq->cpu;
 		rq->curr_process = old_p->parent;
 	}
-	//if the parent is null, but there are still processes on the queue
-	else if(rq->head != NULL){
-		rq->curr_process = rq->head;
-	}
-	//if everything is gone, curr_process is NULL
-	else{
-		rq->curr_process = NULL;
-	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+
+	//sched_wake takes the lock itself
+	if (resume)
+		sched_wake(old_p->parent);
 	return 0;
 }
 
 
 /*
- * uint32_t remove_process_from_runqueue()
- *   DESCRIPTION: pops the head from the runqueue and pushes it to the tail
- *   INPUTS: none
+ * int32_t enqueue_task(runqueue_t * rq, pcb_t * p)
+ *   DESCRIPTION: queues a runnable process at the tail of its mlfq level
+ *   INPUTS: rq - a runqueue, whose lock the caller holds
+ * 			 p - a runnable process that is not queued or running
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success, ERROR - failure
  *   SIDE EFFECTS: changes the runqueue
  */
-int32_t runqueue_rotate() {
-	//check for null
-	if (scheduler.head == NULL || scheduler.tail == NULL) return ERROR;
-	//update the linked list putting the head at the back of the queue
-	if (scheduler.head != scheduler.tail) {
-		//here I do not use push and pop because this is less lines.
-		scheduler.tail->next = scheduler.head;
-		scheduler.head->prev = scheduler.tail;
-		scheduler.head = scheduler.head->next;
-		scheduler.tail = scheduler.tail->next;
-		scheduler.tail->next = NULL;
-		scheduler.head->prev = NULL;
+int32_t enqueue_task(runqueue_t * rq, pcb_t * p) {
+	uint32_t level;
+
+	if (rq == NULL || p == NULL || p->on_rq) return ERROR;
+
+	level = p->priority;
+	p->next = NULL;
+	p->prev = rq->tail[level];
+	if (rq->tail[level] == NULL)
+		rq->head[level] = p;
+	else
+		rq->tail[level]->next = p;
+	rq->tail[level] = p;
+
+	rq->bitmap |= (1 << level);
+	p->on_rq = 1;
+	p->cpu = rq->cpu;
+	rq->size += 1;
+
+	//a second runnable task needs its quantum timed. the preempted
+	//process pick_next_task puts back doesn't count, it is just passing.
+	//another cpu's queue is its own business, it just gets told. work
+	//left waiting here is worth an idle cpu coming to steal it
+	if (p != rq->curr_process) {
+		if (rq == this_rq()) {
+			timer_need_ticks();
+			if (rq->curr_process != rq->idle)
+				kick_idle_cpu(rq);
+		} else {
+			smp_send_resched(rq->cpu);
+		}
 	}
 	return 0;
 }
 
 
 /*
- * uint32_t push()
- *   DESCRIPTION: pushes to the end of the queue
- *   INPUTS: rq - a runqueue
- * 			 new_p - a pcb to be pushed
+ * int32_t dequeue_task(runqueue_t * rq, pcb_t * p)
+ *   DESCRIPTION: takes a queued process off its mlfq level
+ *   INPUTS: rq - a runqueue, whose lock the caller holds
+ * 			 p - a queued process
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success, ERROR - failure
  *   SIDE EFFECTS: changes the runqueue
  */
-int32_t push(runqueue_t * rq, pcb_t * new_p) {
-	//check for NULL
-	if (rq == NULL || new_p == NULL) return ERROR;
-	//check if size condition is met
-	if (rq->size >= rq->max_size) return ERROR;
-	//if this is the first element
-	if (rq->size == 0) {
-		rq->head = new_p;
-		rq->head->prev = NULL;
-		rq->tail = new_p;
-		rq->tail->next = NULL;
-	}
-	//if this is not the first
-	else {
-		rq->tail->next = new_p;
-		new_p->prev = rq->tail;
-		new_p->next = NULL;
-		rq->tail = new_p;
-	}
-	//increment size
-	rq->size += 1;
+int32_t dequeue_task(runqueue_t * rq, pcb_t * p) {
+	uint32_t level;
+
+	if (rq == NULL || p == NULL || !p->on_rq) return ERROR;
+
+	level = p->priority;
+	if (p->prev == NULL)
+		rq->head[level] = p->next;
+	else
+		p->prev->next = p->next;
+	if (p->next == NULL)
+		rq->tail[level] = p->prev;
+	else
+		p->next->prev = p->prev;
+	p->next = NULL;
+	p->prev = NULL;
+
+	if (rq->head[level] == NULL)
+		rq->bitmap &= ~(1 << level);
+	p->on_rq = 0;
+	rq->size -= 1;
 	return 0;
 }
 
+
 /*
- * pcb_t * pop()
- *   DESCRIPTION: pops from the front of the queue
- *   INPUTS: rq - a runqueue
- * 			 old_p - a pcb to be pushed
+ * pcb_t * pick_next_task()
+ *   DESCRIPTION: puts the current process back at the tail of its level if
+ *                it can still run, then takes the head of the most urgent
+ *                non-empty level and makes it the current process. the
+ *                bitmap finds that level in one instruction, so sleeping
+ *                processes cost nothing here. an empty queue first steals
+ *                from the busiest cpu, and the idle task is made current
+ *                if there is nothing to steal either
+ *   INPUTS: none
  *   OUTPUTS: none
- *   RETURN VALUE: ret - success, NULL - failure
+ *   RETURN VALUE: the process to run next
+ *   SIDE EFFECTS: changes this cpu's runqueue and its curr_process
+ */
+pcb_t * pick_next_task() {
+	runqueue_t * rq = this_rq();
+	pcb_t * prev;
+	pcb_t * next;
+	uint32_t level, flags;
+
+	flags = spin_lock_irqsave(&rq->lock);
+	prev = rq->curr_process;
+	rq->need_resched = 0;
+
+	if (prev != NULL && prev != rq->idle && prev->state == TASK_RUNNING)
+		enqueue_task(rq, prev);
+
+	//idle while stealing, so what we steal doesn't look like work piling
+	//up behind a running process
+	if (rq->bitmap == 0) {
+		rq->curr_process = rq->idle;
+		if (steal_task(rq) == ERROR) {
+			spin_unlock_irqrestore(&rq->lock, flags);
+			return rq->idle;
+		}
+	}
+
+	asm volatile ("bsfl %1, %0" : "=r" (level) : "rm" (rq->bitmap));
+	next = rq->head[level];
+	dequeue_task(rq, next);
+
+	rq->curr_process = next;
+	spin_unlock_irqrestore(&rq->lock, flags);
+	return next;
+}
+
+
+/*
+ * int32_t sched_tick(pcb_t * current)
+ *   DESCRIPTION: charges a tick to the running process. it keeps the
+ *                cpu until its quantum runs out, which also drops it a
+ *                level, or until a more urgent task wakes up
+ *   INPUTS: current - the process the tick interrupted
+ *   OUTPUTS: none
+ *   RETURN VALUE: nonzero if the scheduler should pick again
+ *   SIDE EFFECTS: updates mlfq levels, boosts everyone now and then
+ */
+int32_t sched_tick(pcb_t * current) {
+	runqueue_t * rq = this_rq();
+
+	if (++rq->balance_ticks >= SCHED_BALANCE_TICKS) {
+		rq->balance_ticks = 0;
+		balance(rq);
+	}
+
+	//long running tasks sink to the bottom, lift them before they starve
+	if (++rq->boost_ticks >= MLFQ_BOOST_TICKS) {
+		rq->boost_ticks = 0;
+		boost_all();
+		return 1;
+	}
+
+	if (current == rq->idle || current->state != TASK_RUNNING)
+		return 1;
+
+	if (--current->slice_left == 0) {
+		if (current->priority < MLFQ_LEVELS - 1) {
+			current->priority++;
+			kstats.sched_demotions++;
+		}
+		current->slice_left = MLFQ_SLICE(current->priority);
+		return 1;
+	}
+
+	return rq->need_resched;
+}
+
+
+/*
+ * void boost_all()
+ *   DESCRIPTION: moves every process queued on this cpu, and the running
+ *                one, back to level 0 with a fresh quantum. sleepers get
+ *                the same when they wake, so they are left alone
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
  *   SIDE EFFECTS: changes the runqueue
  */
-pcb_t * pop(runqueue_t * rq, pcb_t * old_p) {
-	//the return value
-	pcb_t * ret;
-	//check for null
-	if (rq == NULL || old_p == NULL) return NULL;
-	//check for in bounds
-	if (rq->size <= 0) return NULL;
-	ret = rq->head;
-	//if there is only 1 element in queue
-	if (rq->size == 1) {
-		rq->head = NULL;
-		rq->tail = NULL;
-	}
-	//if there is more than 1 element in queue
-	else {
-		rq->head = rq->head->next;
-		rq->head->prev = NULL;
-	}
-	//decrement size
-	// ret->prev == NULL;
-	// ret->next == NULL;
-	rq->size -= 1;
+static void boost_all() {
+	runqueue_t * rq = this_rq();
+	pcb_t * current;
+	pcb_t * it;
+	uint32_t level, flags;
+
+	flags = spin_lock_irqsave(&rq->lock);
+	current = rq->curr_process;
+
+	for (level = 1; level < MLFQ_LEVELS; level++) {
+		while ((it = rq->head[level]) != NULL) {
+			dequeue_task(rq, it);
+			it->priority = 0;
+			it->slice_left = MLFQ_SLICE(0);
+			enqueue_task(rq, it);
+		}
+	}
+
+	if (current != NULL && current != rq->idle) {
+		current->priority = 0;
+		current->slice_left = MLFQ_SLICE(0);
+	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+	kstats.sched_boosts++;
+}
+
+
+/*
+ * void context_switch()
+ *   DESCRIPTION: switches to next's address space and kernel stack. returns
+ *                once some later switch comes back to current. cr3 is left
+ *                alone when the tlb already matches next's mappings, and
+ *                the idle task, which only touches kernel mappings, runs
+ *                in whichever address space it finds. a forked child that
+ *                never ran has nothing to return into, so it is given a
+ *                frame that starts it in ret_from_fork
+ *   INPUTS: current - the process whose stack we are on
+ *           next - the process to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may write cr3, writes the tss, must be called with
+ *                 interrupts off and the kernel lock held
+ */
+void context_switch(pcb_t * current, pcb_t * next) {
+	cpu_t * cpu = this_cpu();
+	switch_frame_t * frame;
+
+	switch_start = rdtsc();
+	if (next == cpu->rq.idle && current->state != TASK_ZOMBIE) {
+		//current's tlb entries stay warm for when it comes back. a process
+		//that halted frees its page tables, so idle does not stay on those
+		kstats.ctx_switch_cr3_skips++;
+	} else if (cpu->mm_dir == next->page_dir) {
+		//nothing changed next's mappings since this cpu last loaded them
+		kstats.ctx_switch_cr3_skips++;
+	} else {
+		load_page_directory(next->page_dir);
+	}
+
+	cpu->tss->esp0 = KERNEL_STACK_TOP(next->pid);
+	next->cpu = cpu->id;
+	//the kernel lock stays with this cpu. an interrupt that nested in the
+	//kernel may hold it more than once, so the depth goes with the process
+	current->lock_depth = cpu->lock_depth;
+
+	if (next->first_run) {
+		next->first_run = 0;
+		next->lock_depth = 1;	//dropped once in syscall_return
+		frame = (switch_frame_t *)next->curr_esp - 1;
+		memset(frame, 0, sizeof(switch_frame_t));
+		frame->eip = (uint32_t)ret_from_fork;
+		next->curr_esp = (uint32_t)frame;
+		switch_account();
+	}
+	cpu->lock_depth = next->lock_depth;
+
+	switch_to(&current->curr_esp, next->curr_esp);
+
+	//on current's stack again, some later switch came back to it
+	switch_account();
+}
+
+
+/*
+ * void switch_account()
+ *   DESCRIPTION: counts the switch that just finished and how long it took.
+ *                the time is read before stats_lock is taken, so taking it
+ *                is not part of what switchbench reports
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates kstats.ctx_switches and ctx_switch_cycles
+ */
+static void switch_account() {
+	uint32_t cycles = rdtsc() - switch_start;
+
+	spin_lock(&stats_lock);
+	kstats.ctx_switches++;
+	kstats.ctx_switch_cycles += cycles;
+	spin_unlock(&stats_lock);
+}
+
+
+/*
+ * void sched_wake(pcb_t * p)
+ *   DESCRIPTION: makes a process that was waiting runnable again. it goes
+ *                back to the top level with a fresh quantum, since tasks
+ *                that block a lot are the interactive ones. it is queued
+ *                on the cpu it last ran on, whose caches still hold it
+ *   INPUTS: p - the blocked process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: queues p unless it is taking over the cpu directly, asks
+ *                 for a reschedule at the next timer interrupt if p is more urgent
+ *                 than the running process
+ */
+void sched_wake(pcb_t * p) {
+	runqueue_t * rq = &cpus[p->cpu].rq;
+	pcb_t * current;
+	uint32_t flags;
+
+	flags = spin_lock_irqsave(&rq->lock);
+	current = rq->curr_process;
+	p->state = TASK_RUNNING;
+	p->priority = 0;
+	p->slice_left = MLFQ_SLICE(0);
+
+	if (p != current) {
+		if (current == NULL || current == rq->idle || current->priority > 0)
+			rq->need_resched = 1;
+		enqueue_task(rq, p);
+	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+
+/*
+ * void sched_block()
+ *   DESCRIPTION: gives the cpu away until the current process, which the
+ *                caller already took out of TASK_RUNNING, is runnable
+ *                again. it is on no run queue meanwhile, only on whatever
+ *                wait list the caller put it on
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches processes, must be called with interrupts off
+ */
+void sched_block() {
+	pcb_t * current = this_rq()->curr_process;
+
+	while (current->state != TASK_RUNNING)
+		context_switch(current, pick_next_task());
+}
+
+
+/*
+ * int32_t sched_place(pcb_t * p)
+ *   DESCRIPTION: queues a new background process (forked, spawned or a
+ *                boot shell) on the online cpu with the least work,
+ *                counting what it queued and what it is running
+ *   INPUTS: p - a runnable process that is on no cpu yet
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - success, ERROR - failure
+ *   SIDE EFFECTS: changes that cpu's runqueue, may send it an IPI
+ */
+int32_t sched_place(pcb_t * p) {
+	runqueue_t * best = this_rq();
+	runqueue_t * rq;
+	uint32_t cpu, load, best_load = (uint32_t)-1, flags;
+	int32_t ret;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (!cpus[cpu].online)
+			continue;
+		rq = &cpus[cpu].rq;
+		load = rq_load(rq);
+		if (load < best_load) {
+			best = rq;
+			best_load = load;
+		}
+	}
+
+	flags = spin_lock_irqsave(&best->lock);
+	ret = enqueue_task(best, p);
+	spin_unlock_irqrestore(&best->lock, flags);
 	return ret;
 }
+
+
+/*
+ * void sched_resched()
+ *   DESCRIPTION: runs on a cpu another one queued work for. starts timing
+ *                quanta, and leaves the idle task or a less urgent process
+ *                right away if the new one should run first. a system call
+ *                this interrupted is not switched out halfway, it does that
+ *                itself on the way out, see sched_preempt
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch processes, must hold the kernel lock
+ */
+void sched_resched() {
+	runqueue_t * rq = this_rq();
+	pcb_t * current = rq->curr_process;
+	pcb_t * next;
+
+	if (rq->size > 0)
+		timer_need_ticks();
+	if (current == NULL || !(rq->need_resched || current == rq->idle))
+		return;
+	if (this_cpu()->lock_depth > 1)
+		return;
+
+	if ((next = pick_next_task()) != current)
+		context_switch(current, next);
+}
+
+
+/*
+ * void sched_preempt()
+ *   DESCRIPTION: the last thing a system call does before letting go of
+ *                the kernel lock. interrupts stay on in system calls, and
+ *                a tick or IPI that came in meanwhile only set need_resched
+ *                rather than switch out a task in the middle of one. the
+ *                switch it put off happens here
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch processes, leaves interrupts off for the iret
+ */
+void sched_preempt() {
+	irq_save();
+	if (this_cpu()->lock_depth == 1 && this_rq()->need_resched)
+		sched_resched();
+}
+
+
+/*
+ * uint32_t rq_load(runqueue_t * rq)
+ *   DESCRIPTION: counts the work a cpu has, queued and running
+ *   INPUTS: rq - a cpu's runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: runnable processes on that cpu
+ *   SIDE EFFECTS: none
+ */
+static uint32_t rq_load(runqueue_t * rq) {
+	return rq->size + (rq->curr_process != NULL && rq->curr_process != rq->idle);
+}
+
+
+/*
+ * pcb_t * migrate_task(runqueue_t * from, runqueue_t * to)
+ *   DESCRIPTION: moves one queued process to another cpu. it is taken from
+ *                the tail of from's least urgent level, the end its owner
+ *                would get to last, so the owner's next picks are untouched.
+ *                a queued process need not be switched out yet: pick_next_task
+ *                queues prev, and a wake up from another cpu can queue it,
+ *                while its cpu is still on its stack in context_switch. that
+ *                cpu holds the kernel lock until switch_to is done, and every
+ *                caller here holds it too, so what we move is off its stack
+ *   INPUTS: from - runqueue with something queued
+ *           to - another cpu's runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: the process moved
+ *   SIDE EFFECTS: changes both runqueues, whose locks the caller holds,
+ *                 may send an IPI
+ */
+static pcb_t * migrate_task(runqueue_t * from, runqueue_t * to) {
+	pcb_t * p;
+	uint32_t level;
+
+	asm volatile ("bsrl %1, %0" : "=r" (level) : "rm" (from->bitmap));
+	p = from->tail[level];
+	dequeue_task(from, p);
+	enqueue_task(to, p);
+	kstats.sched_migrations++;
+	return p;
+}
+
+
+/*
+ * int32_t steal_task(runqueue_t * rq)
+ *   DESCRIPTION: fills this cpu's empty queue with a process waiting on the
+ *                cpu with the most queued, instead of idling beside it
+ *   INPUTS: rq - this cpu's runqueue, locked
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - rq has work now, ERROR - nobody had any to spare
+ *   SIDE EFFECTS: changes both runqueues, may drop and retake rq's lock
+ */
+static int32_t steal_task(runqueue_t * rq) {
+	runqueue_t * victim = NULL;
+	uint32_t cpu;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (cpu == rq->cpu || !cpus[cpu].online || cpus[cpu].rq.size == 0)
+			continue;
+		if (victim == NULL || cpus[cpu].rq.size > victim->size)
+			victim = &cpus[cpu].rq;
+	}
+	if (victim == NULL)
+		return ERROR;
+
+	//the victim was picked without its lock, and ours may have been let go
+	//of to take both in order, so look again
+	double_rq_lock(rq, victim);
+	if (rq->bitmap == 0 && victim->size > 0) {
+		migrate_task(victim, rq);
+		kstats.sched_steals++;
+	}
+	spin_unlock(&victim->lock);
+	return rq->bitmap ? 0 : ERROR;
+}
+
+
+/*
+ * void balance(runqueue_t * rq)
+ *   DESCRIPTION: the periodic check for imbalance stealing can't see. a
+ *                cpu that keeps one process has an empty queue but never
+ *                idles, so it never steals. the busy cpu, which is the one
+ *                still taking ticks, hands it one instead
+ *   INPUTS: rq - this cpu's runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may move a process to another cpu
+ */
+static void balance(runqueue_t * rq) {
+	runqueue_t * least = NULL;
+	uint32_t cpu, flags;
+
+	if (rq->size == 0)
+		return;
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (cpu == rq->cpu || !cpus[cpu].online)
+			continue;
+		if (least == NULL || rq_load(&cpus[cpu].rq) < rq_load(least))
+			least = &cpus[cpu].rq;
+	}
+	if (least == NULL || rq_load(rq) < rq_load(least) + SCHED_IMBALANCE)
+		return;
+
+	flags = spin_lock_irqsave(&rq->lock);
+	double_rq_lock(rq, least);
+	if (rq->size > 0 && rq_load(rq) >= rq_load(least) + SCHED_IMBALANCE)
+		migrate_task(rq, least);
+	spin_unlock(&least->lock);
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+
+/*
+ * void kick_idle_cpu(runqueue_t * rq)
+ *   DESCRIPTION: something is waiting on a busy cpu's queue. an idle cpu
+ *                halts with its timer off, so tell one to come steal it
+ *   INPUTS: rq - this cpu's runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may send an IPI
+ */
+static void kick_idle_cpu(runqueue_t * rq) {
+	uint32_t cpu;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (cpu == rq->cpu || !cpus[cpu].online)
+			continue;
+		if (cpus[cpu].rq.curr_process == cpus[cpu].rq.idle && cpus[cpu].rq.size == 0) {
+			smp_send_resched(cpu);
+			return;
+		}
+	}
+}
+
+
+/*
+ * void double_rq_lock(runqueue_t * held, runqueue_t * other)
+ *   DESCRIPTION: takes a second run queue's lock. they go in cpu order, so
+ *                if other comes first the one we hold is let go and taken
+ *                again after it, and anything read under it must be
+ *                checked again
+ *   INPUTS: held - a runqueue whose lock this cpu holds
+ *           other - another cpu's runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: spins, interrupts must be off
+ */
+static void double_rq_lock(runqueue_t * held, runqueue_t * other) {
+	if (other->cpu > held->cpu) {
+		spin_lock(&other->lock);
+		return;
+	}
+	spin_unlock(&held->lock);
+	spin_lock(&other->lock);
+	spin_lock(&held->lock);
+}
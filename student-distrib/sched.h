@@ -1,8 +1,9 @@
-#ifndef _IDT_H
-#define _IDT_H
+#ifndef _SCHED_H
+#define _SCHED_H
 
 
 #include "pcb.h"
+#include "spinlock.h"
 
 //task is excecuting currently or waiting to execute
 //task is in a run queue on some processor
@@ -30,39 +31,98 @@
 //task is not in a queue
 #define TASK_ZOMBIE 4
 
-#define SLICE 		10
+//multilevel feedback queue. level 0 is the most urgent. a task that
+//uses up its quantum drops a level, one that wakes from a wait goes back
+//to level 0, and every MLFQ_BOOST_TICKS all of them do so nothing starves
+#define MLFQ_LEVELS			3
+#define MLFQ_SLICE(level)	(1 << (level))	//ticks in a quantum, see SCHED_TICK_US
+#define MLFQ_BOOST_TICKS	50				//a second of ticks
+
+//cpus with nothing queued steal from a busy one's queue as soon as they
+//run dry. every SCHED_BALANCE_TICKS a busy cpu also hands a task to the
+//least loaded one if they are SCHED_IMBALANCE or more apart
+#define SCHED_BALANCE_TICKS	10
+#define SCHED_IMBALANCE		2
+
+//each cpu's idle task has its pcb and kernel stack in an 8KB slot below
+//the last process's, it has no pid of its own and never goes to user space
+#define IDLE_PID(cpu)	(MAX_PROG_NUM + (cpu))
 
 #define ERROR		-1
 
-/*genreral struct for our scheduler*/
+/*genreral struct for our scheduler, one per cpu (see smp.h). only runnable
+  processes that are not running are queued, one fifo per mlfq level.
+  sleepers sit on wait lists. lock guards everything below it, other cpus
+  only read the counts without it*/
 typedef struct runqueue_t
 {
-	uint32_t size;
-	uint32_t max_size;
+	uint32_t cpu;				//the cpu that runs this queue
+	spinlock_t lock;
+	uint32_t size;				//processes queued on all levels
+	uint32_t bitmap;			//bit n is set while level n is not empty
 	struct pcb_t * curr_process;
-	struct pcb_t * head;
-	struct pcb_t * tail;
+	struct pcb_t * head[MLFQ_LEVELS];
+	struct pcb_t * tail[MLFQ_LEVELS];
+	uint32_t need_resched;		//a task above the current one's level woke up
+	uint32_t boost_ticks;		//ticks since every task went back to level 0
+	uint32_t balance_ticks;		//ticks since this cpu last looked at the others
+	struct pcb_t * idle;		//runs whenever nothing else is, never queued
 } runqueue_t;
 
-/*this is the main scheduler for our OS*/
-runqueue_t scheduler;
-
-/*call once to set up the scheduler*/
+/*what switch_to leaves on a kernel stack it switches away from, lowest
+  address first. a process that never ran gets one built by hand*/
+typedef struct switch_frame_t
+{
+	uint32_t edi;
+	uint32_t esi;
+	uint32_t ebx;
+	uint32_t ebp;
+	uint32_t eip;				//where switch_to returns to
+} switch_frame_t;
+
+/*call once to set up every cpu's run queue*/
 extern void sched_init();
 
-/*add a process to the scheduler*/
+/*turn the calling boot thread into its cpu's idle task, does not return*/
+extern void sched_start();
+
+/*queue a new background process on the least busy cpu*/
+extern int32_t sched_place(struct pcb_t * p);
+
+/*look for work after another cpu queued some here*/
+extern void sched_resched();
+
+/*run the switch an interrupt put off, on the way out of a syscall*/
+void sched_preempt();
+
+/*run a foreground process right away*/
 extern int32_t add_process_to_runqueue(runqueue_t * rq, struct pcb_t * new_p);
 
 /*remove a process from the scheduler*/
 extern int32_t remove_process_from_runqueue(runqueue_t * rq, struct pcb_t * old_p);
 
-/*rotate the runqueue*/
-int32_t runqueue_rotate();
+/*queue a runnable process at the tail of its level, rq->lock held*/
+int32_t enqueue_task(runqueue_t * rq, pcb_t * p);
+
+/*take a queued process off its level, rq->lock held*/
+int32_t dequeue_task(runqueue_t * rq, pcb_t * p);
+
+/*take the most urgent runnable process off the queue and make it current*/
+pcb_t * pick_next_task();
+
+/*switch from the current process's kernel stack to next's*/
+void context_switch(pcb_t * current, pcb_t * next);
+
+/*save the callee saved registers and esp in *prev_esp, resume at next_esp*/
+extern void switch_to(uint32_t * prev_esp, uint32_t next_esp);
+
+/*make a blocked process runnable again at the top level*/
+void sched_wake(pcb_t * p);
 
-/*queue pop method*/
-pcb_t * pop(runqueue_t * rq, pcb_t * old_p);
+/*charge a tick to the current process, nonzero if it should be switched out*/
+int32_t sched_tick(pcb_t * current);
 
-/*queue push method*/
-int32_t push(runqueue_t * rq, pcb_t * new_p);
+/*run other processes until the current one is TASK_RUNNING again*/
+void sched_block();
 
 #endif
@@ -0,0 +1,309 @@
+/* shm.c - Named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#include "shm.h"
+#include "frame_alloc.h"
+#include "paging_init.h"
+#include "sched.h"
+#include "lib.h"
+#include "smp.h"
+#include "user_mem.h"
+
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+
+/*
+ * void shm_init()
+ *   DESCRIPTION: marks every segment slot as unused
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the segment table
+ */
+void shm_init() {
+	memset(segments, 0, sizeof(segments));
+}
+
+/*
+ * shm_attach_t* find_attach(pcb_t* pcb, int32_t id)
+ *   DESCRIPTION: finds the slot of pcb that holds segment id
+ *   INPUTS: pcb - process to look in
+ *           id - segment id, or SHM_SLOT_FREE to find an empty slot
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the slot, NULL if there is none
+ *   SIDE EFFECTS: none
+ */
+static shm_attach_t* find_attach(pcb_t* pcb, int32_t id) {
+	uint32_t i;
+
+	for (i = 0; i < MAX_SHM_ATTACH; i++)
+		if (pcb->shm[i].id == id)
+			return &(pcb->shm[i]);
+	return NULL;
+}
+
+/*
+ * void segment_put(shm_segment_t* seg)
+ *   DESCRIPTION: drops a process's hold on a segment, freeing the segment
+ *                and its frames when nobody has it open anymore
+ *   INPUTS: seg - the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may free frames and the segment slot
+ */
+static void segment_put(shm_segment_t* seg) {
+	uint32_t i;
+
+	if (--seg->refs > 0)
+		return;
+
+	//frames that are still mapped somewhere keep their own reference
+	for (i = 0; i < seg->num_pages; i++)
+		frame_free(seg->frames[i]);
+	seg->in_use = 0;
+}
+
+/*
+ * void shm_detach(pcb_t* pcb, shm_attach_t* slot)
+ *   DESCRIPTION: unmaps a segment from pcb (if it was mapped) and lets go of it
+ *   INPUTS: pcb - the process
+ *           slot - the process's slot for the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees the slot
+ */
+static void shm_detach(pcb_t* pcb, shm_attach_t* slot) {
+	shm_segment_t* seg = &segments[slot->id];
+
+	if (slot->addr != SHM_UNMAPPED)
+		unmap_user_range(pcb->page_dir, slot->addr, slot->addr + seg->num_pages * ALIGNED_4KB);
+
+	slot->id = SHM_SLOT_FREE;
+	slot->addr = SHM_UNMAPPED;
+	segment_put(seg);
+}
+
+/*
+ * void shm_release_all(pcb_t* pcb)
+ *   DESCRIPTION: detaches pcb from all of its segments. called from halt
+ *   INPUTS: pcb - the process that is going away
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may free segments
+ */
+void shm_release_all(pcb_t* pcb) {
+	uint32_t i;
+
+	for (i = 0; i < MAX_SHM_ATTACH; i++)
+		if (pcb->shm[i].id != SHM_SLOT_FREE)
+			shm_detach(pcb, &(pcb->shm[i]));
+}
+
+/*
+ * void shm_fork(pcb_t* child)
+ *   DESCRIPTION: a forked child starts out with a copy of its parent's
+ *                slots and mappings, so it holds its own reference on each
+ *                segment the parent has open
+ *   INPUTS: child - the new process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: bumps the segments' reference counts
+ */
+void shm_fork(pcb_t* child) {
+	uint32_t i;
+
+	for (i = 0; i < MAX_SHM_ATTACH; i++)
+		if (child->shm[i].id != SHM_SLOT_FREE)
+			segments[child->shm[i].id].refs++;
+}
+
+/*
+ * void shm_usage(uint32_t* num_segments, uint32_t* num_pages)
+ *   DESCRIPTION: totals the segment table for meminfo
+ *   INPUTS: none
+ *   OUTPUTS: num_segments - segments in use
+ *            num_pages - frames those segments hold
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void shm_usage(uint32_t* num_segments, uint32_t* num_pages) {
+	uint32_t id;
+
+	*num_segments = 0;
+	*num_pages = 0;
+	for (id = 0; id < SHM_MAX_SEGMENTS; id++) {
+		if (segments[id].in_use) {
+			(*num_segments)++;
+			*num_pages += segments[id].num_pages;
+		}
+	}
+}
+
+/*
+ * int32_t shm_copy_name(pcb_t* pcb, const uint8_t* name, int8_t* key)
+ *   DESCRIPTION: copies a segment name in from user memory, checking every
+ *                byte before it is read. the copy is what gets compared and
+ *                stored, the user's string may be in a segment another cpu
+ *                is writing
+ *   INPUTS: pcb - the calling process
+ *           name - name passed by the user
+ *   OUTPUTS: key - SHM_NAME_LEN bytes, the name and its terminator
+ *   RETURN VALUE: 0 on success, ERROR if name is empty, too long or not
+ *                 the caller's memory
+ *   SIDE EFFECTS: none
+ */
+static int32_t shm_copy_name(pcb_t* pcb, const uint8_t* name, int8_t* key) {
+	uint32_t length;
+
+	if (name == NULL)
+		return ERROR;
+	for (length = 0; length < SHM_NAME_LEN; length++) {
+		if (!user_addr_ok(pcb, (uint32_t)&name[length]))
+			return ERROR;
+		if ((key[length] = name[length]) == '\0')
+			return (length > 0) ? 0 : ERROR;
+	}
+	return ERROR;
+}
+
+/*
+ * int32_t shm_open(const uint8_t* name, uint32_t size)
+ *   DESCRIPTION: opens the segment called name, creating it with size bytes
+ *                of zeroed memory if it does not exist yet
+ *   INPUTS: name -- name of the segment
+ *           size -- bytes needed, rounded up to whole pages
+ *   OUTPUTS: none
+ *   RETURN VALUE: segment id on success, ERROR on failure
+ *   SIDE EFFECTS: may allocate frames, takes a slot in the caller's pcb
+ */
+int32_t shm_open(const uint8_t* name, uint32_t size) {
+	pcb_t* curr = this_rq()->curr_process;
+	shm_attach_t* slot;
+	shm_segment_t* seg = NULL;
+	uint32_t num_pages, i;
+	int32_t id;
+	int8_t key[SHM_NAME_LEN];
+
+	if (curr == NULL || shm_copy_name(curr, name, key) == ERROR)
+		return ERROR;
+	num_pages = PAGE_ALIGN_UP(size) / ALIGNED_4KB;
+	if (num_pages == 0 || num_pages > SHM_MAX_PAGES)
+		return ERROR;
+
+	//look for an existing segment with this name
+	for (id = 0; id < SHM_MAX_SEGMENTS; id++) {
+		if (segments[id].in_use && strncmp(segments[id].name, key, SHM_NAME_LEN) == 0) {
+			seg = &segments[id];
+			break;
+		}
+	}
+
+	if (seg != NULL) {
+		if (num_pages > seg->num_pages)
+			return ERROR;
+		//opening twice does not take a second reference
+		if (find_attach(curr, id) != NULL)
+			return id;
+		if ((slot = find_attach(curr, SHM_SLOT_FREE)) == NULL)
+			return ERROR;
+	} else {
+		if ((slot = find_attach(curr, SHM_SLOT_FREE)) == NULL)
+			return ERROR;
+		for (id = 0; id < SHM_MAX_SEGMENTS; id++)
+			if (!segments[id].in_use)
+				break;
+		if (id == SHM_MAX_SEGMENTS)
+			return ERROR;
+
+		seg = &segments[id];
+		for (i = 0; i < num_pages; i++) {
+			if ((seg->frames[i] = frame_alloc_zeroed()) == 0) {
+				while (i-- > 0)
+					frame_free(seg->frames[i]);
+				return ERROR;
+			}
+		}
+		strcpy(seg->name, key);
+		seg->num_pages = num_pages;
+		seg->refs = 0;
+		seg->in_use = 1;
+	}
+
+	seg->refs++;
+	slot->id = id;
+	slot->addr = SHM_UNMAPPED;
+	return id;
+}
+
+/*
+ * int32_t shm_map(int32_t id, void* addr)
+ *   DESCRIPTION: maps an open segment into the caller at addr. every process
+ *                that maps it sees the same physical pages, so data written
+ *                by one is visible to the others without a copy
+ *   INPUTS: id -- segment id returned by shm_open
+ *           addr -- page aligned address in [USER_SHM_START, USER_SHM_END)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR on failure
+ *   SIDE EFFECTS: changes the caller's page tables
+ */
+int32_t shm_map(int32_t id, void* addr) {
+	pcb_t* curr = this_rq()->curr_process;
+	shm_attach_t* slot;
+	shm_segment_t* seg;
+	uint32_t vaddr = (uint32_t)addr;
+	uint32_t i;
+	uint32_t* pte;
+
+	if (curr == NULL || id < 0 || id >= SHM_MAX_SEGMENTS)
+		return ERROR;
+	if ((slot = find_attach(curr, id)) == NULL || slot->addr != SHM_UNMAPPED)
+		return ERROR;
+
+	seg = &segments[id];
+	if (vaddr & (ALIGNED_4KB - 1))
+		return ERROR;
+	if (vaddr < USER_SHM_START || vaddr + seg->num_pages * ALIGNED_4KB > USER_SHM_END)
+		return ERROR;
+
+	//refuse to overlap another segment
+	for (i = 0; i < seg->num_pages; i++) {
+		pte = get_user_pte(curr->page_dir, vaddr + i * ALIGNED_4KB, 0);
+		if (pte != NULL && (*pte & PRESENT))
+			return ERROR;
+	}
+
+	for (i = 0; i < seg->num_pages; i++) {
+		if ((pte = get_user_pte(curr->page_dir, vaddr + i * ALIGNED_4KB, 1)) == NULL) {
+			unmap_user_range(curr->page_dir, vaddr, vaddr + i * ALIGNED_4KB);
+			return ERROR;
+		}
+		frame_ref(seg->frames[i]);
+		//shared pages stay writable across fork
+		*pte = seg->frames[i] | PTE_SHARED | USER_PAGE_FLAGS;
+	}
+
+	slot->addr = vaddr;
+	return 0;
+}
+
+/*
+ * int32_t shm_close(int32_t id)
+ *   DESCRIPTION: unmaps a segment from the caller and closes it. the pages
+ *                are freed when the last process closes the segment
+ *   INPUTS: id -- segment id returned by shm_open
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if the caller does not have it open
+ *   SIDE EFFECTS: changes the caller's page tables
+ */
+int32_t shm_close(int32_t id) {
+	pcb_t* curr = this_rq()->curr_process;
+	shm_attach_t* slot;
+
+	if (curr == NULL || id < 0 || id >= SHM_MAX_SEGMENTS)
+		return ERROR;
+	if ((slot = find_attach(curr, id)) == NULL)
+		return ERROR;
+
+	shm_detach(curr, slot);
+	return 0;
+}
@@ -0,0 +1,48 @@
+/* shm.h - Named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "pcb.h"
+#include "user_mem.h"
+
+#define SHM_MAX_SEGMENTS	8
+#define SHM_MAX_PAGES		64
+#define SHM_NAME_LEN		32
+
+/* segments can be mapped anywhere page aligned in [192MB, 256MB) */
+#define USER_SHM_START		USER_HEAP_END
+#define USER_SHM_END		0x10000000
+
+#define SHM_UNMAPPED		0
+
+#define ERROR				-1
+
+/* general struct for a shared memory segment */
+typedef struct shm_segment_t
+{
+	uint32_t in_use;
+	int8_t name[SHM_NAME_LEN];
+	uint32_t num_pages;
+	uint32_t frames[SHM_MAX_PAGES];	//the segment holds one reference on each
+	uint32_t refs;					//processes that have the segment open
+} shm_segment_t;
+
+/* Clears the segment table */
+void shm_init();
+/* Detaches a process from every segment it still has open */
+void shm_release_all(pcb_t* pcb);
+/* Takes the references a forked child inherits from its parent */
+void shm_fork(pcb_t* child);
+/* Counts the segments in use and the frames they hold */
+void shm_usage(uint32_t* num_segments, uint32_t* num_pages);
+
+/* System calls */
+int32_t shm_open(const uint8_t* name, uint32_t size);
+int32_t shm_map(int32_t id, void* addr);
+int32_t shm_close(int32_t id);
+
+#endif /* _SHM_H */
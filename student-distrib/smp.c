@@ -0,0 +1,507 @@
+/* smp.c - Multiprocessor bring-up, the kernel lock and cross-cpu IPIs
+ * vim:ts=4 noexpandtab
+ */
+
+#include "smp.h"
+#include "spinlock.h"
+#include "apic.h"
+#include "idt.h"
+#include "pit.h"
+#include "timer.h"
+#include "paging_init.h"
+#include "systemcalls.h"
+#include "stats.h"
+#include "lib.h"
+
+/* every cpu runs its own run queue and takes interrupts on its own, but
+ * the kernel below them was written for one cpu. so whoever enters the
+ * kernel, from a syscall, fault or interrupt, first takes one big lock.
+ * faults and interrupts arrive through interrupt gates and keep
+ * interrupts off until they leave. syscalls come through a trap gate and
+ * run with them on, so an interrupt can nest inside one on its cpu: the
+ * lock is recursive for that, and the run queues, terminals, rtc, wait
+ * queues and frame allocator, which handlers share, have spinlocks of
+ * their own (spinlock.h) taken with interrupts off. a nested interrupt
+ * never switches the syscall out, see sched_preempt. the same locks are
+ * what lets the idle task zero frames outside this one */
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus;
+
+static spinlock_t kernel_lock = SPINLOCK_INIT("kernel", LOCK_RANK_KERNEL);
+
+/* TSSs of the application processors, cpus[0] uses the boot one */
+static tss_t ap_tss[MAX_CPUS - 1];
+
+/* low pages low_map identity mapped, to take back out afterwards */
+static uint8_t low_mapped[PG_DIR_TAB_SIZE];
+
+/* the real mode entry point and its parameters, see trampoline.S */
+extern uint8_t ap_trampoline[], ap_trampoline_end[];
+extern uint8_t ap_boot_gdt[];
+extern uint32_t ap_boot_cr0, ap_boot_cr3, ap_boot_cr4;
+extern uint32_t ap_boot_esp, ap_boot_cpu;
+
+/*
+ * void reload_cr3(void)
+ *   DESCRIPTION: reloads cr3 with itself, dropping every non-global tlb
+ *                entry of this cpu
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: flushes the tlb
+ */
+static inline void reload_cr3(void) {
+	uint32_t cr3;
+
+	asm volatile("movl %%cr3, %0; movl %0, %%cr3" : "=r"(cr3) : : "memory");
+}
+
+/*
+ * void smp_init_bsp(void)
+ *   DESCRIPTION: makes the boot cpu cpus[0], the only one until smp_init
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: resets cpus[]
+ */
+void smp_init_bsp(void) {
+	uint32_t i;
+
+	memset(cpus, 0, sizeof(cpus));
+	for (i = 0; i < MAX_CPUS; i++)
+		cpus[i].id = i;
+	cpus[0].tss = &tss;
+	cpus[0].online = 1;
+	num_cpus = 1;
+}
+
+/*
+ * void lock_kernel(void)
+ *   DESCRIPTION: takes the kernel lock. a cpu that already holds it only
+ *                counts one level deeper, since interrupts nest inside
+ *                syscalls. the depth of a task that is switched out is
+ *                saved with it, see context_switch
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: spins until no other cpu is in the kernel, with
+ *                 interrupts on if the caller had them on. picks up tlb
+ *                 flushes missed while spinning. an entry that arrived
+ *                 with interrupts off starts timing that window
+ */
+void lock_kernel(void) {
+	cpu_t* cpu;
+	uint32_t flags;
+
+	//the depth and the lock change together, or an interrupt in between
+	//would spin on a lock its own cpu holds
+	cli_and_save(flags);
+	cpu = this_cpu();
+	if (cpu->lock_depth > 0) {
+		cpu->lock_depth++;
+		restore_flags(flags);
+		return;
+	}
+
+	if (flags & EFLAGS_IF) {
+		//a syscall waits with interrupts on. one that nests here takes and
+		//drops the lock itself, and may even switch us to another cpu
+		while (!spin_trylock(&kernel_lock)) {
+			restore_flags(flags);
+			asm volatile("pause");
+			cli();
+		}
+		cpu = this_cpu();
+	} else {
+		irq_off_begin();
+		spin_lock(&kernel_lock);
+	}
+	cpu->lock_depth = 1;
+
+	if (cpu->tlb_stale) {
+		cpu->tlb_stale = 0;
+		reload_cr3();
+	}
+	restore_flags(flags);
+}
+
+/*
+ * void unlock_kernel(void)
+ *   DESCRIPTION: drops one level of the kernel lock, releasing it with
+ *                the last one
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: lets another cpu into the kernel, ends a timed window
+ */
+void unlock_kernel(void) {
+	cpu_t* cpu;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	cpu = this_cpu();
+	if (--cpu->lock_depth == 0) {
+		spin_unlock(&kernel_lock);
+		irq_off_end();
+	}
+	restore_flags(flags);
+}
+
+/*
+ * void smp_send_resched(uint32_t cpu)
+ *   DESCRIPTION: interrupts cpu so it looks at its run queue again, after
+ *                this cpu woke or placed a task there
+ *   INPUTS: cpu - index into cpus[]
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sends RESCHED_IPI_ENTRY
+ */
+void smp_send_resched(uint32_t cpu) {
+	if (cpu == smp_cpu_id() || !cpus[cpu].online)
+		return;
+	lapic_send_ipi(cpus[cpu].apic_id, RESCHED_IPI_ENTRY);
+	kstats.resched_ipis++;
+}
+
+/*
+ * void smp_flush_tlb_page(uint32_t vaddr)
+ *   DESCRIPTION: drops a mapping every address space shares, like the
+ *                vidmap page, from all cpus. the others are only marked
+ *                and interrupted, not waited for. the kernel never goes
+ *                through such a mapping, but a program on another cpu
+ *                drawing through vidmap keeps the old entry until the IPI
+ *                lands, and what it writes meanwhile goes to the old page
+ *                and is lost. the caller holds screen_lock with interrupts
+ *                off, and a cpu spinning for that lock the same way would
+ *                never take the IPI, so waiting here could deadlock
+ *   INPUTS: vaddr - virtual address whose mapping changed
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: flushes this cpu's entry, sends TLB_IPI_ENTRY to the rest
+ */
+void smp_flush_tlb_page(uint32_t vaddr) {
+	uint32_t i, self = smp_cpu_id();
+
+	flush_tlb_page(vaddr);
+	for (i = 0; i < MAX_CPUS; i++) {
+		if (i == self || !cpus[i].online)
+			continue;
+		cpus[i].tlb_stale = 1;
+		lapic_send_ipi(cpus[i].apic_id, TLB_IPI_ENTRY);
+	}
+}
+
+/*
+ * void resched_ipi_handler(void)
+ *   DESCRIPTION: another cpu queued work here, run it if it should preempt
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch tasks
+ */
+void resched_ipi_handler(void) {
+	lock_kernel();
+	lapic_eoi();
+	sched_resched();
+	unlock_kernel();
+}
+
+/*
+ * void tlb_ipi_handler(void)
+ *   DESCRIPTION: another cpu changed a shared mapping. runs without the
+ *                kernel lock so a program here stops using the old entry
+ *                as soon as the IPI arrives, not once a system call on
+ *                another cpu is done
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: flushes this cpu's tlb
+ */
+void tlb_ipi_handler(void) {
+	cpu_t* cpu;
+
+	lapic_eoi();
+	cpu = this_cpu();
+	if (cpu->tlb_stale) {
+		cpu->tlb_stale = 0;
+		reload_cr3();
+	}
+}
+
+/*
+ * void* low_map(uint32_t addr, uint32_t len)
+ *   DESCRIPTION: makes [addr, addr + len) readable at the same virtual
+ *                address. below 4MB only video memory is mapped, so
+ *                missing pages there are added until low_unmap
+ *   INPUTS: addr - physical address
+ *           len - bytes needed
+ *   OUTPUTS: none
+ *   RETURN VALUE: addr as a pointer, NULL if it is beyond kernel memory
+ *   SIDE EFFECTS: may add page_table entries
+ */
+static void* low_map(uint32_t addr, uint32_t len) {
+	uint32_t page;
+
+	if (addr + len > KERNEL_MEM_END || addr + len < addr)
+		return NULL;
+	for (page = addr >> LOWER_12_BITS;
+		 page < LOW_MEM_END >> LOWER_12_BITS && page <= (addr + len - 1) >> LOWER_12_BITS;
+		 page++) {
+		if (page_table[page] & PRESENT)
+			continue;
+		page_table[page] = (page << LOWER_12_BITS) | READ_WRITE | PRESENT;
+		low_mapped[page] = 1;
+	}
+	return (void*)addr;
+}
+
+/*
+ * void low_unmap(void)
+ *   DESCRIPTION: takes out every page low_map added
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears page_table entries, flushes them
+ */
+static void low_unmap(void) {
+	uint32_t page;
+
+	for (page = 0; page < PG_DIR_TAB_SIZE; page++) {
+		if (!low_mapped[page])
+			continue;
+		page_table[page] = 0;
+		low_mapped[page] = 0;
+		flush_tlb_page(page << LOWER_12_BITS);
+	}
+}
+
+/*
+ * uint8_t mp_sum(uint8_t* p, uint32_t len)
+ *   DESCRIPTION: adds up bytes, MP structures sum to 0
+ *   INPUTS: p - start
+ *           len - bytes to add
+ *   OUTPUTS: none
+ *   RETURN VALUE: the sum modulo 256
+ *   SIDE EFFECTS: none
+ */
+static uint8_t mp_sum(uint8_t* p, uint32_t len) {
+	uint8_t sum = 0;
+
+	while (len--)
+		sum += *p++;
+	return sum;
+}
+
+/*
+ * uint8_t* mp_scan(uint32_t addr, uint32_t len)
+ *   DESCRIPTION: looks for the MP floating pointer on 16 byte boundaries
+ *   INPUTS: addr - physical start of the area
+ *           len - its size
+ *   OUTPUTS: none
+ *   RETURN VALUE: the floating pointer, NULL if it is not there
+ *   SIDE EFFECTS: maps the area
+ */
+static uint8_t* mp_scan(uint32_t addr, uint32_t len) {
+	uint8_t* p = low_map(addr, len);
+	uint8_t* end = p + len;
+
+	if (p == NULL)
+		return NULL;
+	for (; p + MP_FLOAT_SIZE <= end; p += MP_FLOAT_SIZE)
+		if (*(uint32_t*)p == MP_FLOAT_SIG && mp_sum(p, MP_FLOAT_SIZE) == 0)
+			return p;
+	return NULL;
+}
+
+/*
+ * uint32_t mp_find_cpus(void)
+ *   DESCRIPTION: reads the processors out of the BIOS's MP configuration
+ *                table into cpus[1..], the boot cpu already being cpus[0]
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: processors found, counting the boot cpu
+ *   SIDE EFFECTS: maps low memory, see low_unmap
+ */
+static uint32_t mp_find_cpus(void) {
+	uint8_t* mpf;
+	uint8_t* cfg;
+	uint8_t* entry;
+	uint32_t ebda, i, count, found = 1;
+
+	ebda = (uint32_t)(*(uint16_t*)low_map(BDA_EBDA_SEG, sizeof(uint16_t))) << 4;
+	mpf = NULL;
+	if (ebda)
+		mpf = mp_scan(ebda, EBDA_SCAN_SIZE);
+	if (mpf == NULL)
+		mpf = mp_scan(BASE_MEM_TOP - EBDA_SCAN_SIZE, EBDA_SCAN_SIZE);
+	if (mpf == NULL)
+		mpf = mp_scan(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+	if (mpf == NULL)
+		return found;
+
+	// no table means one of the spec's default configurations, which only
+	// have two cpus and no way to tell their ids here
+	if (*(uint32_t*)(mpf + 4) == 0)
+		return found;
+	cfg = low_map(*(uint32_t*)(mpf + 4), MP_CONFIG_HDR_SIZE);
+	if (cfg == NULL || *(uint32_t*)cfg != MP_CONFIG_SIG)
+		return found;
+	cfg = low_map((uint32_t)cfg, *(uint16_t*)(cfg + 4));
+	if (cfg == NULL || mp_sum(cfg, *(uint16_t*)(cfg + 4)) != 0)
+		return found;
+
+	count = *(uint16_t*)(cfg + 34);
+	entry = cfg + MP_CONFIG_HDR_SIZE;
+	for (i = 0; i < count; i++) {
+		if (entry[0] != MP_ENTRY_PROC) {
+			entry += MP_OTHER_SIZE;
+			continue;
+		}
+		if ((entry[3] & MP_PROC_ENABLED) && !(entry[3] & MP_PROC_BSP) && found < MAX_CPUS)
+			cpus[found++].apic_id = entry[1];
+		entry += MP_PROC_SIZE;
+	}
+	return found;
+}
+
+/*
+ * void ap_tss_init(uint32_t id)
+ *   DESCRIPTION: gives an application processor its TSS and the GDT entry
+ *                CPU_TSS(id) for it
+ *   INPUTS: id - index into cpus[], at least 1
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the GDT
+ */
+static void ap_tss_init(uint32_t id) {
+	seg_desc_t the_tss_desc;
+	tss_t* ap = &ap_tss[id - 1];
+
+	memset(ap, 0, sizeof(tss_t));
+	the_tss_desc.granularity    = 0;
+	the_tss_desc.opsize         = 0;
+	the_tss_desc.reserved       = 0;
+	the_tss_desc.avail          = 0;
+	the_tss_desc.seg_lim_19_16  = TSS_SIZE & 0x000F0000;
+	the_tss_desc.present        = 1;
+	the_tss_desc.dpl            = 0x0;
+	the_tss_desc.sys            = 0;
+	the_tss_desc.type           = 0x9;
+	the_tss_desc.seg_lim_15_00  = TSS_SIZE & 0x0000FFFF;
+
+	SET_TSS_PARAMS(the_tss_desc, ap, tss_size);
+
+	ap_tss_desc_ptr[id - 1] = the_tss_desc;
+
+	ap->ldt_segment_selector = KERNEL_LDT;
+	ap->ss0 = KERNEL_DS;
+	ap->esp0 = KERNEL_STACK_TOP(IDLE_PID(id));
+	cpus[id].tss = ap;
+}
+
+/*
+ * int32_t boot_ap(uint32_t id)
+ *   DESCRIPTION: starts an application processor with INIT and two
+ *                STARTUP IPIs, as the MP spec has it, and waits for it to
+ *                reach ap_main. one that doesn't in time is sent INIT
+ *                again, since it may still be on its way in and would take
+ *                the next AP's stack and id from the trampoline
+ *   INPUTS: id - index into cpus[], its apic_id filled in
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 once it is online, ERROR if it never came up
+ *   SIDE EFFECTS: rewrites the trampoline page, may reset the cpu
+ */
+static int32_t boot_ap(uint32_t id) {
+	cpu_t* cpu = &cpus[id];
+	uint32_t tries;
+
+	ap_tss_init(id);
+	ap_boot_esp = KERNEL_STACK_TOP(IDLE_PID(id));
+	ap_boot_cpu = id;
+	memcpy((void*)TRAMPOLINE_ADDR, ap_trampoline, ap_trampoline_end - ap_trampoline);
+
+	lapic_send_init(cpu->apic_id);
+	pit_delay(INIT_DELAY_CLOCKS);
+	lapic_send_startup(cpu->apic_id, TRAMPOLINE_ADDR >> LOWER_12_BITS);
+	pit_delay(STARTUP_DELAY_CLOCKS);
+	if (!cpu->online) {
+		lapic_send_startup(cpu->apic_id, TRAMPOLINE_ADDR >> LOWER_12_BITS);
+		pit_delay(STARTUP_DELAY_CLOCKS);
+	}
+	for (tries = 0; !cpu->online && tries < AP_BOOT_TRIES; tries++)
+		pit_delay(INIT_DELAY_CLOCKS);
+	if (cpu->online)
+		return 0;
+
+	//too late. back to waiting for a startup IPI, wherever it got to. at
+	//worst it is spinning on the kernel lock, which we hold
+	lapic_send_init(cpu->apic_id);
+	pit_delay(INIT_DELAY_CLOCKS);
+	cpu->online = 0;
+	return ERROR;
+}
+
+/*
+ * void smp_init(void)
+ *   DESCRIPTION: finds the other processors and starts each on its own
+ *                idle task and run queue. device interrupts keep going
+ *                to the boot cpu through the 8259. call after timer_init
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: takes the kernel lock for the boot cpu, which keeps it
+ *                 until sched_start, so APs wait there for the shells
+ */
+void smp_init(void) {
+	uint32_t id, found, cr;
+
+	lock_kernel();
+	kstats.cpus_online = num_cpus;
+	if (!lapic_ready())
+		return;
+	cpus[0].apic_id = lapic_id();
+
+	found = mp_find_cpus();
+	if (found > 1) {
+		// the APs come up in real mode on the trampoline page and then
+		// turn on paging with our cr3, so it is mapped at its own address
+		low_map(TRAMPOLINE_ADDR, ALIGNED_4KB);
+		asm volatile("sgdt (%0)" : : "r"(ap_boot_gdt) : "memory");
+		asm volatile("movl %%cr0, %0" : "=r"(cr));
+		ap_boot_cr0 = cr;
+		asm volatile("movl %%cr3, %0" : "=r"(cr));
+		ap_boot_cr3 = cr;
+		asm volatile("movl %%cr4, %0" : "=r"(cr));
+		ap_boot_cr4 = cr;
+
+		for (id = 1; id < found; id++) {
+			if (boot_ap(id) == 0)
+				num_cpus++;
+			else
+				printf("cpu %d (apic %d) did not start\n", id, cpus[id].apic_id);
+		}
+	}
+	low_unmap();
+	kstats.cpus_online = num_cpus;
+}
+
+/*
+ * void ap_main(uint32_t id)
+ *   DESCRIPTION: where an application processor enters C, from the
+ *                trampoline on its idle stack. loads this cpu's tables and
+ *                timer, then idles until its run queue gets work
+ *   INPUTS: id - index into cpus[]
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: marks the cpu online
+ */
+void ap_main(uint32_t id) {
+	lidt(idt_desc_ptr);
+	ltr(CPU_TSS(id));
+	lldt(KERNEL_LDT);
+
+	cpus[id].online = 1;
+	lock_kernel();
+	timer_init_ap();
+	sched_start();
+}
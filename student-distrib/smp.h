@@ -0,0 +1,113 @@
+/* smp.h - Multiprocessor bring-up and per-cpu state
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+/* page below 1MB application processors start in, in real mode */
+#define TRAMPOLINE_ADDR		0x7000
+
+#ifndef ASM
+
+#include "types.h"
+#include "x86_desc.h"
+#include "sched.h"
+
+/* MP floating pointer and configuration table, Intel MP spec 1.4 */
+#define MP_FLOAT_SIG		0x5F504D5F	//"_MP_"
+#define MP_CONFIG_SIG		0x504D4350	//"PCMP"
+#define MP_FLOAT_SIZE		16
+#define MP_CONFIG_HDR_SIZE	44
+#define MP_ENTRY_PROC		0
+#define MP_PROC_SIZE		20
+#define MP_OTHER_SIZE		8
+#define MP_PROC_ENABLED		0x1
+#define MP_PROC_BSP			0x2
+
+/* where the BIOS may have put the floating pointer */
+#define BDA_EBDA_SEG		0x40E		//bios data area word holding the ebda's segment
+#define EBDA_SCAN_SIZE		0x400
+#define BASE_MEM_TOP		0xA0000		//its last kB is scanned without an ebda
+#define BIOS_ROM_START		0xF0000
+#define BIOS_ROM_END		0x100000
+
+#define LOW_MEM_END			0x00400000	//mapped through page_table, see low_map
+#define KERNEL_MEM_END		0x04000000	//identity mapped by the kernel's 4MB pages
+
+#define INIT_DELAY_CLOCKS	11932		//10ms of PIT clocks after INIT
+#define STARTUP_DELAY_CLOCKS	239		//200us after each startup IPI
+#define AP_BOOT_TRIES		50			//10ms waits for an AP to come online
+
+#define ERROR				-1
+
+/* what each processor keeps to itself. the boot cpu is cpus[0] */
+typedef struct cpu_t
+{
+	uint32_t id;				//index into cpus[], found from the task register
+	uint32_t apic_id;			//local APIC id, where IPIs are sent
+	volatile uint32_t online;	//booted and scheduling
+	volatile uint32_t tlb_stale;	//another cpu changed a shared mapping
+	uint32_t lock_depth;		//times this cpu holds the kernel lock
+	uint32_t irq_off_since;		//tsc when interrupts went off, 0 if not timing
+	uint32_t* mm_dir;			//page directory in cr3 whose mappings the tlb
+								//matches, NULL if unsure. see load_page_directory
+	tss_t* tss;					//kernel stack for entries from user space
+	runqueue_t rq;				//processes this cpu runs
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+/* processors that came online, 1 without an MP table or local APIC */
+extern uint32_t num_cpus;
+
+/*
+ * uint32_t smp_cpu_id(void)
+ *   DESCRIPTION: tells which cpu this runs on. every cpu loaded its own
+ *                TSS, so the task register is a free per-cpu variable
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: index into cpus[]
+ *   SIDE EFFECTS: none
+ */
+static inline uint32_t smp_cpu_id(void)
+{
+	uint16_t tr;
+	asm volatile("str %0" : "=r"(tr));
+	return (tr == KERNEL_TSS) ? 0 : ((tr - AP_TSS_BASE) >> 3) + 1;
+}
+
+/* The cpu this runs on */
+static inline cpu_t* this_cpu(void)
+{
+	return &cpus[smp_cpu_id()];
+}
+
+/* The run queue of the cpu this runs on */
+static inline runqueue_t* this_rq(void)
+{
+	return &cpus[smp_cpu_id()].rq;
+}
+
+/* Sets up the boot cpu, call once the task register is loaded */
+void smp_init_bsp(void);
+/* Finds the other processors in the MP table and starts them */
+void smp_init(void);
+/* C entry of an application processor, from the trampoline */
+void ap_main(uint32_t id);
+
+/* Takes the kernel lock, recursively */
+void lock_kernel(void);
+/* Drops one level of the kernel lock */
+void unlock_kernel(void);
+
+/* Asks cpu to look at its run queue */
+void smp_send_resched(uint32_t cpu);
+/* Drops a shared mapping from every cpu's tlb */
+void smp_flush_tlb_page(uint32_t vaddr);
+
+extern void resched_ipi_handler();
+extern void tlb_ipi_handler();
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
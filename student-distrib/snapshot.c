@@ -0,0 +1,248 @@
+/* snapshot.c - Named snapshots of initialized processes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "snapshot.h"
+#include "frame_alloc.h"
+#include "paging_init.h"
+#include "user_mem.h"
+#include "meminfo.h"
+#include "sched.h"
+#include "stats.h"
+#include "lib.h"
+#include "smp.h"
+
+static snapshot_t snapshots[SNAPSHOT_MAX];
+
+/*
+ * void snapshot_init()
+ *   DESCRIPTION: marks every snapshot slot as unused
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the snapshot table
+ */
+void snapshot_init() {
+	memset(snapshots, 0, sizeof(snapshots));
+}
+
+/*
+ * int32_t snapshot_name_ok(pcb_t* pcb, const uint8_t* name)
+ *   DESCRIPTION: checks that name can be stored in a snapshot slot. the
+ *                string is still in user memory, every byte is checked
+ *                before it is read
+ *   INPUTS: pcb - the calling process
+ *           name - name passed by the user
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it can, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t snapshot_name_ok(pcb_t* pcb, const uint8_t* name) {
+	uint32_t length;
+
+	if (name == NULL)
+		return 0;
+	for (length = 0; length < SNAPSHOT_NAME_LEN; length++) {
+		if (!user_addr_ok(pcb, (uint32_t)&name[length]))
+			return 0;
+		if (name[length] == '\0')
+			return length > 0;
+	}
+	return 0;
+}
+
+/*
+ * snapshot_t* snapshot_find(const uint8_t* name)
+ *   DESCRIPTION: looks up the snapshot taken under name
+ *   INPUTS: name - usually the file name of a program being started
+ *   OUTPUTS: none
+ *   RETURN VALUE: the snapshot, NULL if there is none
+ *   SIDE EFFECTS: none
+ */
+snapshot_t* snapshot_find(const uint8_t* name) {
+	uint32_t i;
+
+	for (i = 0; i < SNAPSHOT_MAX; i++)
+		if (snapshots[i].in_use && strncmp(snapshots[i].name, (const int8_t*)name, SNAPSHOT_NAME_LEN) == 0)
+			return &snapshots[i];
+	return NULL;
+}
+
+/*
+ * void snapshot_put(snapshot_t* snap)
+ *   DESCRIPTION: drops the snapshot's references on its pages and frees
+ *                its page directory. clones keep their own references
+ *   INPUTS: snap - the snapshot
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees the slot
+ */
+static void snapshot_put(snapshot_t* snap) {
+	free_user_mappings(snap->page_dir);
+	frame_free((uint32_t)snap->page_dir);
+	snap->in_use = 0;
+}
+
+/*
+ * int32_t snapshot_clone(snapshot_t* snap, pcb_t* pcb, exec_args_t* args)
+ *   DESCRIPTION: shares every page of the snapshot with pcb copy on write
+ *                and puts the snapshot's registers at the top of pcb's
+ *                kernel stack, so it resumes from the snapshot call. the
+ *                clone gets the arguments it was launched with, not the
+ *                ones the snapshot was taken with
+ *   INPUTS: snap - the snapshot
+ *           pcb - a new process with an empty address space, loaded
+ *           args - argv and envp of the launch
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if memory ran out or args do not fit
+ *                 where the snapshot's were. on failure the caller cleans
+ *                 up with free_user_mappings
+ *   SIDE EFFECTS: maps pages into pcb->page_dir
+ */
+int32_t snapshot_clone(snapshot_t* snap, pcb_t* pcb, exec_args_t* args) {
+	if (copy_user_pages(snap->page_dir, pcb->page_dir) == ERROR)
+		return ERROR;
+
+	// the snapshot's vidmap table belongs to the terminal it was taken on
+	if (snap->vidmap)
+		pcb->page_dir[VIDMAP_PG_DIR_OFFSET] = ((uint32_t)vidmap_page_table_array[pcb->tid]) | USER_SUPERVISOR | READ_WRITE | PRESENT;
+	else
+		pcb->page_dir[VIDMAP_PG_DIR_OFFSET] = 0;
+
+	pcb->heap_start = snap->heap_start;
+	pcb->brk = snap->brk;
+	pcb->argc = snap->argc;
+	pcb->argv = snap->argv;
+	pcb->envp = snap->envp;
+	if (replace_exec_args(pcb->page_dir, pcb, args) == ERROR)
+		return ERROR;
+	memcpy(USER_FRAME(pcb->pid), &snap->frame, sizeof(syscall_frame_t));
+
+	kstats.snapshot_clones++;
+	return 0;
+}
+
+/*
+ * void snapshot_copy_files(snapshot_t* snap, pcb_t* pcb)
+ *   DESCRIPTION: hands pcb the file descriptors the snapshot was taken
+ *                with, the code after the snapshot call still uses them
+ *   INPUTS: snap - the snapshot
+ *           pcb - the clone, after init_pcb
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites pcb's descriptors
+ */
+void snapshot_copy_files(snapshot_t* snap, pcb_t* pcb) {
+	memcpy(pcb->file_desc_array, snap->file_desc_array, sizeof(pcb->file_desc_array));
+	pcb->capacity = snap->capacity;
+}
+
+/*
+ * void snapshot_usage(uint32_t* num_snapshots, uint32_t* num_pages)
+ *   DESCRIPTION: totals the snapshot table for meminfo
+ *   INPUTS: none
+ *   OUTPUTS: num_snapshots - snapshots in use
+ *            num_pages - pages they map, many of them shared with clones
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void snapshot_usage(uint32_t* num_snapshots, uint32_t* num_pages) {
+	uint32_t i;
+
+	*num_snapshots = 0;
+	*num_pages = 0;
+	for (i = 0; i < SNAPSHOT_MAX; i++) {
+		if (snapshots[i].in_use) {
+			(*num_snapshots)++;
+			*num_pages += count_user_pages(snapshots[i].page_dir, NULL);
+		}
+	}
+}
+
+/*
+ * int32_t snapshot(const uint8_t* name)
+ *   DESCRIPTION: saves the caller's memory, registers and open files under
+ *                name, replacing an older snapshot of that name. from now
+ *                on starting the program called name resumes a copy of
+ *                the caller from here. pages are shared copy on write
+ *   INPUTS: name - the file name the caller was started from, a program
+ *                  may only stand in for itself
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 in the caller and in every clone, ERROR if name is not
+ *                 the caller's, the table is full, memory ran out or the
+ *                 caller has shared memory open (clones would end up
+ *                 sharing it too)
+ *   SIDE EFFECTS: write protects the caller's private pages
+ */
+int32_t snapshot(const uint8_t* name) {
+	pcb_t* curr = this_rq()->curr_process;
+	snapshot_t* snap;
+	uint32_t* pg_dir;
+	uint32_t i;
+
+	if (curr == NULL || !snapshot_name_ok(curr, name))
+		return ERROR;
+	if (strncmp(curr->filename, (const int8_t*)name, MAX_STRING_LEN) != 0)
+		return ERROR;
+	for (i = 0; i < MAX_SHM_ATTACH; i++)
+		if (curr->shm[i].id != SHM_SLOT_FREE)
+			return ERROR;
+
+	if ((snap = snapshot_find(name)) == NULL) {
+		for (i = 0; i < SNAPSHOT_MAX; i++)
+			if (!snapshots[i].in_use)
+				break;
+		if (i == SNAPSHOT_MAX)
+			return ERROR;
+		snap = &snapshots[i];
+	}
+
+	if ((pg_dir = (uint32_t*)frame_alloc_zeroed()) == NULL)
+		return ERROR;
+	if (copy_user_pages(curr->page_dir, pg_dir) == ERROR) {
+		free_user_mappings(pg_dir);
+		frame_free((uint32_t)pg_dir);
+		load_page_directory(curr->page_dir);
+		return ERROR;
+	}
+	// our writable pages just became read only
+	load_page_directory(curr->page_dir);
+
+	if (snap->in_use)
+		snapshot_put(snap);
+
+	snap->in_use = 1;
+	strncpy(snap->name, (const int8_t*)name, SNAPSHOT_NAME_LEN);
+	snap->page_dir = pg_dir;
+	memcpy(&snap->frame, USER_FRAME(curr->pid), sizeof(syscall_frame_t));
+	snap->vidmap = curr->page_dir[VIDMAP_PG_DIR_OFFSET] & PRESENT;
+	snap->heap_start = curr->heap_start;
+	snap->brk = curr->brk;
+	snap->argc = curr->argc;
+	snap->argv = curr->argv;
+	snap->envp = curr->envp;
+	memcpy(snap->file_desc_array, curr->file_desc_array, sizeof(snap->file_desc_array));
+	snap->capacity = curr->capacity;
+
+	return 0;
+}
+
+/*
+ * int32_t snapshot_drop(const uint8_t* name)
+ *   DESCRIPTION: forgets the snapshot taken under name, the program starts
+ *                from the top again
+ *   INPUTS: name - name the snapshot was taken under
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if there is no such snapshot
+ *   SIDE EFFECTS: frees the snapshot's pages that no clone still uses
+ */
+int32_t snapshot_drop(const uint8_t* name) {
+	pcb_t* curr = this_rq()->curr_process;
+	snapshot_t* snap;
+
+	if (curr == NULL || !snapshot_name_ok(curr, name) || (snap = snapshot_find(name)) == NULL)
+		return ERROR;
+
+	snapshot_put(snap);
+	return 0;
+}
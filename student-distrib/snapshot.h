@@ -0,0 +1,51 @@
+/* snapshot.h - Named snapshots of initialized processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include "types.h"
+#include "pcb.h"
+#include "systemcalls.h"
+#include "exec_args.h"
+
+#define SNAPSHOT_MAX		4
+#define SNAPSHOT_NAME_LEN	32
+
+#define ERROR				-1
+
+/* a process frozen right after its setup. launching the program it is
+ * named after resumes a copy of it instead of starting from the top */
+typedef struct snapshot_t
+{
+	uint32_t in_use;
+	int8_t name[SNAPSHOT_NAME_LEN];
+	uint32_t* page_dir;			//user mappings only, private pages are copy on write
+	syscall_frame_t frame;		//registers of the snapshot call
+	uint32_t vidmap;			//had video memory mapped
+	uint32_t heap_start;
+	uint32_t brk;
+	uint32_t argc;
+	uint32_t argv;
+	uint32_t envp;
+	uint32_t capacity;
+	file_desc_t file_desc_array[FD_ARRAY_MAX];
+} snapshot_t;
+
+/* Clears the snapshot table */
+void snapshot_init();
+/* Finds the snapshot taken under name */
+snapshot_t* snapshot_find(const uint8_t* name);
+/* Gives a new process the memory and registers of a snapshot */
+int32_t snapshot_clone(snapshot_t* snap, pcb_t* pcb, exec_args_t* args);
+/* Gives a new process the files the snapshot had open */
+void snapshot_copy_files(snapshot_t* snap, pcb_t* pcb);
+/* Counts the snapshots taken and the pages they keep alive */
+void snapshot_usage(uint32_t* num_snapshots, uint32_t* num_pages);
+
+/* System calls */
+int32_t snapshot(const uint8_t* name);
+int32_t snapshot_drop(const uint8_t* name);
+
+#endif /* _SNAPSHOT_H */
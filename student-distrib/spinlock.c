@@ -0,0 +1,393 @@
+/* spinlock.c - Spinlocks, interrupt-saving spinlocks and reader-writer locks
+ * vim:ts=4 noexpandtab
+ */
+
+#include "spinlock.h"
+#include "smp.h"
+#include "stats.h"
+#include "lib.h"
+
+/* a lock a cpu holds, for the order check */
+typedef struct held_lock_t
+{
+	const void* lock;
+	uint32_t rank;
+	const char* name;
+} held_lock_t;
+
+#ifdef LOCK_DEBUG
+static held_lock_t held[MAX_CPUS][LOCK_HELD_MAX];
+static uint32_t num_held[MAX_CPUS];
+#endif
+
+/*
+ * uint32_t xchg(volatile uint32_t* addr, uint32_t val)
+ *   DESCRIPTION: atomically swaps val into *addr
+ *   INPUTS: addr - word to swap
+ *           val - new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: the old value
+ *   SIDE EFFECTS: locks the bus for the swap
+ */
+static inline uint32_t xchg(volatile uint32_t* addr, uint32_t val) {
+	asm volatile("xchgl %0, %1"
+		: "+r"(val), "+m"(*addr)
+		:
+		: "memory");
+	return val;
+}
+
+/*
+ * uint32_t cmpxchg(volatile uint32_t* addr, uint32_t old, uint32_t val)
+ *   DESCRIPTION: atomically stores val in *addr if it still holds old
+ *   INPUTS: addr - word to change
+ *           old - value it must have
+ *           val - new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: what *addr held, old if the store happened
+ *   SIDE EFFECTS: locks the bus for the compare and store
+ */
+static inline uint32_t cmpxchg(volatile uint32_t* addr, uint32_t old, uint32_t val) {
+	uint32_t prev;
+
+	asm volatile("lock; cmpxchgl %2, %1"
+		: "=a"(prev), "+m"(*addr)
+		: "r"(val), "0"(old)
+		: "memory");
+	return prev;
+}
+
+/*
+ * void lock_acquire(const void* lock, uint32_t rank, const char* name, int32_t check)
+ *   DESCRIPTION: under LOCK_DEBUG, remembers that this cpu holds lock and,
+ *                if check is set, complains when taking it breaks the rank
+ *                order. checked before spinning, so an order that could
+ *                deadlock is reported even the times it doesn't
+ *   INPUTS: lock - the lock being taken
+ *           rank - its LOCK_RANK_*
+ *           name - what to call it
+ *           check - zero for trylocks, which can't deadlock
+ *   OUTPUTS: prints the offending pair of locks
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: counts kstats.lock_order_violations
+ */
+static void lock_acquire(const void* lock, uint32_t rank, const char* name, int32_t check) {
+#ifdef LOCK_DEBUG
+	uint32_t cpu = smp_cpu_id();
+	held_lock_t* top;
+
+	if (check && num_held[cpu] > 0) {
+		top = &held[cpu][num_held[cpu] - 1];
+		if (rank < top->rank || (rank == top->rank && lock <= top->lock)) {
+			printf("lock order: %s (rank %d) taken holding %s (rank %d) on cpu %d\n",
+				name, rank, top->name, top->rank, cpu);
+			kstats.lock_order_violations++;
+		}
+	}
+	if (num_held[cpu] < LOCK_HELD_MAX) {
+		held[cpu][num_held[cpu]].lock = lock;
+		held[cpu][num_held[cpu]].rank = rank;
+		held[cpu][num_held[cpu]].name = name;
+	}
+	num_held[cpu]++;
+#endif
+}
+
+/*
+ * void lock_release(const void* lock)
+ *   DESCRIPTION: under LOCK_DEBUG, forgets that this cpu holds lock. locks
+ *                are normally dropped in reverse order, but need not be
+ *   INPUTS: lock - the lock being dropped
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void lock_release(const void* lock) {
+#ifdef LOCK_DEBUG
+	uint32_t cpu = smp_cpu_id();
+	uint32_t i;
+
+	if (num_held[cpu] == 0)
+		return;
+	if (num_held[cpu] > LOCK_HELD_MAX) {
+		num_held[cpu]--;
+		return;
+	}
+	for (i = num_held[cpu]; i-- > 0; ) {
+		if (held[cpu][i].lock != lock)
+			continue;
+		for (; i + 1 < num_held[cpu]; i++)
+			held[cpu][i] = held[cpu][i + 1];
+		num_held[cpu]--;
+		return;
+	}
+#endif
+}
+
+/*
+ * void spin_lock_init(spinlock_t* lock, const char* name, uint32_t rank)
+ *   DESCRIPTION: sets up an unlocked spinlock
+ *   INPUTS: lock - the lock
+ *           name - what lock order reports call it
+ *           rank - its LOCK_RANK_*
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void spin_lock_init(spinlock_t* lock, const char* name, uint32_t rank) {
+	lock->locked = 0;
+	lock->rank = rank;
+	lock->name = name;
+}
+
+/*
+ * void rwlock_init(rwlock_t* lock, const char* name, uint32_t rank)
+ *   DESCRIPTION: sets up an unlocked reader-writer lock
+ *   INPUTS: lock - the lock
+ *           name - what lock order reports call it
+ *           rank - its LOCK_RANK_*
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void rwlock_init(rwlock_t* lock, const char* name, uint32_t rank) {
+	lock->value = 0;
+	lock->rank = rank;
+	lock->name = name;
+}
+
+/*
+ * void spin_lock(spinlock_t* lock)
+ *   DESCRIPTION: takes a spinlock. the inner loop only reads, so waiting
+ *                cpus don't keep stealing the line from each other
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: spins until the lock is free
+ */
+void spin_lock(spinlock_t* lock) {
+	lock_acquire(lock, lock->rank, lock->name, 1);
+	while (xchg(&lock->locked, 1)) {
+		while (lock->locked)
+			asm volatile("pause");
+	}
+}
+
+/*
+ * void spin_unlock(spinlock_t* lock)
+ *   DESCRIPTION: drops a spinlock. x86 keeps stores in order, so a plain
+ *                store after a compiler barrier is enough
+ *   INPUTS: lock - a lock this cpu holds
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: lets a waiting cpu in
+ */
+void spin_unlock(spinlock_t* lock) {
+	lock_release(lock);
+	asm volatile("" : : : "memory");
+	lock->locked = 0;
+}
+
+/*
+ * int32_t spin_trylock(spinlock_t* lock)
+ *   DESCRIPTION: takes a spinlock only if it is free
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it was taken, 0 if someone else holds it
+ *   SIDE EFFECTS: none
+ */
+int32_t spin_trylock(spinlock_t* lock) {
+	if (xchg(&lock->locked, 1))
+		return 0;
+	lock_acquire(lock, lock->rank, lock->name, 0);
+	return 1;
+}
+
+/*
+ * uint32_t spin_lock_irqsave(spinlock_t* lock)
+ *   DESCRIPTION: turns interrupts off on this cpu and takes a spinlock, so
+ *                an interrupt handler wanting it can't spin on its own cpu
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: the flags to hand spin_unlock_irqrestore
+ *   SIDE EFFECTS: spins until the lock is free
+ */
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+	uint32_t flags = irq_save();
+
+	spin_lock(lock);
+	return flags;
+}
+
+/*
+ * void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags)
+ *   DESCRIPTION: drops a spinlock and puts interrupts back how they were
+ *   INPUTS: lock - a lock this cpu holds
+ *           flags - from spin_lock_irqsave
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may enable interrupts
+ */
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+	spin_unlock(lock);
+	irq_restore(flags);
+}
+
+/*
+ * void read_lock(rwlock_t* lock)
+ *   DESCRIPTION: enters as one of possibly many readers, once no writer
+ *                is inside
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: spins while a writer holds it
+ */
+void read_lock(rwlock_t* lock) {
+	uint32_t val;
+
+	lock_acquire(lock, lock->rank, lock->name, 1);
+	for (;;) {
+		val = lock->value;
+		if (!(val & RW_WRITER) && cmpxchg(&lock->value, val, val + 1) == val)
+			return;
+		asm volatile("pause");
+	}
+}
+
+/*
+ * void read_unlock(rwlock_t* lock)
+ *   DESCRIPTION: leaves as a reader
+ *   INPUTS: lock - a lock this cpu reads under
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the last reader out lets a writer in
+ */
+void read_unlock(rwlock_t* lock) {
+	lock_release(lock);
+	asm volatile("lock; decl %0" : "+m"(lock->value) : : "memory");
+}
+
+/*
+ * void write_lock(rwlock_t* lock)
+ *   DESCRIPTION: enters alone, once every reader and writer has left
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: spins until the lock is free
+ */
+void write_lock(rwlock_t* lock) {
+	lock_acquire(lock, lock->rank, lock->name, 1);
+	while (cmpxchg(&lock->value, 0, RW_WRITER) != 0) {
+		while (lock->value)
+			asm volatile("pause");
+	}
+}
+
+/*
+ * void write_unlock(rwlock_t* lock)
+ *   DESCRIPTION: leaves as the writer
+ *   INPUTS: lock - a lock this cpu writes under
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: lets readers or another writer in
+ */
+void write_unlock(rwlock_t* lock) {
+	lock_release(lock);
+	asm volatile("" : : : "memory");
+	lock->value = 0;
+}
+
+/* read_lock and write_lock with interrupts off, see spin_lock_irqsave */
+uint32_t read_lock_irqsave(rwlock_t* lock) {
+	uint32_t flags = irq_save();
+
+	read_lock(lock);
+	return flags;
+}
+
+void read_unlock_irqrestore(rwlock_t* lock, uint32_t flags) {
+	read_unlock(lock);
+	irq_restore(flags);
+}
+
+uint32_t write_lock_irqsave(rwlock_t* lock) {
+	uint32_t flags = irq_save();
+
+	write_lock(lock);
+	return flags;
+}
+
+void write_unlock_irqrestore(rwlock_t* lock, uint32_t flags) {
+	write_unlock(lock);
+	irq_restore(flags);
+}
+
+/*
+ * void irq_off_begin(void)
+ *   DESCRIPTION: notes that interrupts just went off on this cpu. only
+ *                timed once the cpu schedules, boot is one long window
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_off_begin(void) {
+	cpu_t* cpu = this_cpu();
+
+	if (cpu->rq.idle != NULL)
+		cpu->irq_off_since = rdtsc();
+}
+
+/*
+ * void irq_off_end(void)
+ *   DESCRIPTION: interrupts are about to go back on, keeps the longest
+ *                window seen. cpus outside the kernel lock may race on the
+ *                maximum, which can only lose a sample
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates kstats.irq_off_max_cycles
+ */
+void irq_off_end(void) {
+	cpu_t* cpu = this_cpu();
+	uint32_t cycles;
+
+	if (cpu->irq_off_since == 0)
+		return;
+	cycles = rdtsc() - cpu->irq_off_since;
+	cpu->irq_off_since = 0;
+	if (cycles > kstats.irq_off_max_cycles)
+		kstats.irq_off_max_cycles = cycles;
+}
+
+/*
+ * uint32_t irq_save(void)
+ *   DESCRIPTION: turns interrupts off on this cpu, timing the window if
+ *                they were on
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the flags to hand irq_restore
+ *   SIDE EFFECTS: disables interrupts
+ */
+uint32_t irq_save(void) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if (flags & EFLAGS_IF)
+		irq_off_begin();
+	return flags;
+}
+
+/*
+ * void irq_restore(uint32_t flags)
+ *   DESCRIPTION: puts interrupts back how irq_save found them
+ *   INPUTS: flags - from irq_save
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may enable interrupts
+ */
+void irq_restore(uint32_t flags) {
+	if (flags & EFLAGS_IF)
+		irq_off_end();
+	restore_flags(flags);
+}
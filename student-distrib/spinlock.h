@@ -0,0 +1,76 @@
+/* spinlock.h - Spinlocks, interrupt-saving spinlocks and reader-writer locks
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+/* lock ranks. a cpu may only take a lock ranked above every lock it
+ * already holds, locks of one rank in increasing address order (the run
+ * queues, by cpu). build with -DLOCK_DEBUG to have that checked */
+#define LOCK_RANK_KERNEL	0	//the big kernel lock, see smp.c
+#define LOCK_RANK_SCREEN	1	//which terminal owns the screen
+#define LOCK_RANK_TERM		2	//a terminal's line buffer
+#define LOCK_RANK_RTC		3	//the rtc's registers and tick count
+#define LOCK_RANK_WAIT		4	//a wait queue's list of sleepers
+#define LOCK_RANK_RQ		5	//a cpu's run queue
+#define LOCK_RANK_FRAME		6	//the frame allocator
+#define LOCK_RANK_STATS		7	//counters kstats updates together, innermost
+
+#define LOCK_HELD_MAX		8	//locks a cpu can hold at once under LOCK_DEBUG
+#define EFLAGS_IF			0x200
+
+#define RW_WRITER			0x80000000	//rwlock_t value while a writer holds it
+
+typedef struct spinlock_t
+{
+	volatile uint32_t locked;
+	uint32_t rank;
+	const char* name;
+} spinlock_t;
+
+/* many readers or one writer. readers are not held back by a waiting
+ * writer, so keep write sections rare */
+typedef struct rwlock_t
+{
+	volatile uint32_t value;	//readers inside, or RW_WRITER
+	uint32_t rank;
+	const char* name;
+} rwlock_t;
+
+#define SPINLOCK_INIT(name, rank)	{ 0, (rank), (name) }
+#define RWLOCK_INIT(name, rank)		{ 0, (rank), (name) }
+
+/* Sets up a lock at run time, for locks inside other structures */
+void spin_lock_init(spinlock_t* lock, const char* name, uint32_t rank);
+void rwlock_init(rwlock_t* lock, const char* name, uint32_t rank);
+
+/* Plain locks, for state interrupt handlers never touch or for code that
+ * already runs with interrupts off */
+void spin_lock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+int32_t spin_trylock(spinlock_t* lock);
+
+/* Also turn interrupts off on this cpu, for state a handler shares */
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+
+void read_lock(rwlock_t* lock);
+void read_unlock(rwlock_t* lock);
+void write_lock(rwlock_t* lock);
+void write_unlock(rwlock_t* lock);
+uint32_t read_lock_irqsave(rwlock_t* lock);
+void read_unlock_irqrestore(rwlock_t* lock, uint32_t flags);
+uint32_t write_lock_irqsave(rwlock_t* lock);
+void write_unlock_irqrestore(rwlock_t* lock, uint32_t flags);
+
+/* Interrupts off and back on for this cpu, timing how long they stay off */
+uint32_t irq_save(void);
+void irq_restore(uint32_t flags);
+/* The same timing for windows that began with an interrupt or syscall */
+void irq_off_begin(void);
+void irq_off_end(void);
+
+#endif /* _SPINLOCK_H */
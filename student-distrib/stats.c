@@ -0,0 +1,58 @@
+/* stats.c - Counters the kernel keeps for performance measurements
+ * vim:ts=4 noexpandtab
+ */
+
+#include "stats.h"
+#include "user_mem.h"
+#include "sched.h"
+#include "lib.h"
+#include "smp.h"
+
+kstats_t kstats;
+uint32_t boot_tsc;
+spinlock_t stats_lock = SPINLOCK_INIT("stats", LOCK_RANK_STATS);
+
+/*
+ * void stats_init()
+ *   DESCRIPTION: resets all of the kernel counters
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: zeroes kstats
+ */
+void stats_init() {
+	memset(&kstats, 0, sizeof(kstats_t));
+}
+
+/*
+ * int32_t getstats(void* buf, int32_t nbytes)
+ *   DESCRIPTION: copies a snapshot of the kernel counters to the user
+ *   INPUTS: buf -- user buffer to copy into
+ * 			 nbytes -- size of buf, at most sizeof(kstats_t) bytes are copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes copied, ERROR on failure
+ *   SIDE EFFECTS: writes to buf
+ */
+int32_t getstats(void* buf, int32_t nbytes) {
+	pcb_t* curr = this_rq()->curr_process;
+	kstats_t snap;
+	uint32_t flags;
+
+	if (curr == NULL || buf == NULL || nbytes <= 0)
+		return ERROR;
+
+	if (nbytes > sizeof(kstats_t))
+		nbytes = sizeof(kstats_t);
+	if (!user_addr_ok(curr, (uint32_t)buf) ||
+		!user_addr_ok(curr, (uint32_t)buf + nbytes - 1))
+		return ERROR;
+
+	//the counters that go together agree with each other in the snapshot.
+	//it is copied out after, so a fault on buf never comes in under the lock
+	flags = spin_lock_irqsave(&stats_lock);
+	snap = kstats;
+	spin_unlock_irqrestore(&stats_lock, flags);
+	memcpy(buf, &snap, nbytes);
+
+	return nbytes;
+}
@@ -0,0 +1,61 @@
+/* stats.h - Counters the kernel keeps for performance measurements
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "types.h"
+#include "spinlock.h"
+
+#define ERROR		-1
+
+/* general struct for kernel statistics, copied out by the getstats syscall.
+ * new fields only ever get appended so older programs keep working. */
+typedef struct kstats_t
+{
+	uint32_t pit_ticks;			//scheduler ticks (1/HZ s) of time since boot
+	uint32_t ctx_switches;		//number of context switches done by the scheduler
+	uint32_t ctx_switch_cycles;	//tsc cycles spent switching (wraps, use deltas)
+	uint32_t tlb_full_flushes;	//cr3 loads, each drops every non-global tlb entry
+	uint32_t tlb_page_flushes;	//single entries dropped with invlpg
+	uint32_t page_faults;		//page faults taken, resolved or not
+	uint32_t pages_zeroed;		//frames zero filled on first touch
+	uint32_t forks;				//processes created by fork
+	uint32_t cow_copies;		//copy on write pages that had to be copied
+	uint32_t zero_pool_depth;	//frames currently waiting in the zero pool
+	uint32_t zero_pool_hits;	//zeroed allocations served from the pool
+	uint32_t zero_pool_misses;	//zeroed allocations that had to memset
+	uint32_t boot_ready_cycles;	//tsc cycles from entry until every shell read input
+	uint32_t boot_ready_ticks;	//ticks at that point, for boots too long for the tsc
+	uint32_t snapshot_clones;	//processes started from a snapshot instead of their image
+	uint32_t vid_flips;			//back buffers published by vid_flip
+	uint32_t wait_sleeps;		//times a process slept on a wait queue
+	uint32_t idle_ticks;		//ticks the idle task had the cpu
+	uint32_t sched_demotions;	//quanta used up, dropping a task a level
+	uint32_t sched_boosts;		//times every task went back to the top level
+	uint32_t timer_irqs;		//timer interrupts taken, local APIC or PIT
+	uint32_t tsc_per_us;		//tsc cycles in a microsecond, measured at boot
+	uint32_t timer_sleeps;		//times a process slept in usleep
+	uint32_t cpus_online;		//processors scheduling, the boot cpu included
+	uint32_t resched_ipis;		//cpus interrupted to run work queued from another
+	uint32_t sched_steals;		//processes an idle cpu took from a busy one's queue
+	uint32_t sched_migrations;	//processes moved between cpus, steals included
+	uint32_t irq_off_max_cycles;	//longest a scheduling cpu kept interrupts off
+	uint32_t lock_order_violations;	//out of order locking seen, LOCK_DEBUG only
+	uint32_t ctx_switch_cr3_skips;	//switches that kept the loaded page directory
+} kstats_t;
+
+extern kstats_t kstats;
+/* held while counters that only make sense together are updated */
+extern spinlock_t stats_lock;
+/* tsc when the kernel was entered, before the counters are set up */
+extern uint32_t boot_tsc;
+
+/* Zeroes all the counters */
+void stats_init();
+
+/* Copies the kernel counters into a user buffer */
+int32_t getstats(void* buf, int32_t nbytes);
+
+#endif /* _STATS_H */
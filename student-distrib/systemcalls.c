@@ -5,12 +5,23 @@
 #include "terminal.h"
 #include "x86_desc.h"
 #include "sched.h"
+#include "stats.h"
+#include "user_mem.h"
+#include "shm.h"
+#include "exec_args.h"
+#include "snapshot.h"
+#include "smp.h"
 
 uint32_t vidmap_term0[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 uint32_t vidmap_term1[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 uint32_t vidmap_term2[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 uint32_t* vidmap_page_table_array[NUM_TERMS] = {vidmap_term0, vidmap_term1, vidmap_term2};
 
+/* too big for the kernel stack. system calls hold the kernel lock and the
+ * interrupts that nest in them don't make any, so only one
+ * execute/spawn/exec uses it at a time */
+static exec_args_t exec_args;
+
 /*
  * void switch_to_user_mode(uint32_t esp_new, uint32_t eip_new)
  *   DESCRIPTION: prepares for and switched from kernel mode to user mode
@@ -165,102 +176,207 @@ void flush_tlb() {
         :
         : "eax"
     );
+	kstats.tlb_full_flushes++;
 }
 
-
 /*
- * int32_t add_args_to_buf(uint8_t* buf, const uint8_t* command, const uint32_t filename_end)
- *   DESCRIPTION: Adds the arguments to a buffer
- *   INPUTS: buf - The buffer we will fill
- *           command - The shell command
- *           filename_end - The index of where the argument begins
+ * void load_current_page_directory()
+ *   DESCRIPTION: Switches back to the address space of the running process,
+ *                or to the boot page directory if nothing is running yet
+ *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Fills in the buffer
+ *   SIDE EFFECTS: writes cr3
  */
-int32_t add_args_to_buf(uint8_t* buf, const uint8_t* command, const uint32_t filename_end) {
-	uint32_t i, j;
-	i = filename_end;
-	j = 0;
-
-    if(buf == NULL)
-        return ERROR;
+void load_current_page_directory() {
+	if(this_rq()->curr_process != NULL)
+		load_page_directory(this_rq()->curr_process->page_dir);
+	else
+		load_page_directory(page_directory);
+}
 
-	if(filename_end == ERROR)
-		return ERROR;
 
-	// removes all leading whitespace
-	while(command[i] == ' ')
-		i++;
+/*
+ * int32_t load_program(uint32_t* pg_dir, int32_t inode, uint32_t file_length)
+ *   DESCRIPTION: copies a program image to LOAD_ADDR in 4KB frames. the
+ *                rest of the 4MB (bss and stack) is filled in on first touch
+ *   INPUTS: pg_dir - page directory of the new process, must be loaded
+ *           inode - inode of the executable
+ *           file_length - size of the executable
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if successful, ERROR if failed
+ *   SIDE EFFECTS: maps pages into pg_dir
+ */
+static int32_t load_program(uint32_t* pg_dir, int32_t inode, uint32_t file_length) {
+	uint32_t vaddr;
 
-	while(command[i] != '\0')
-		buf[j++] = command[i++];
+	for(vaddr = LOAD_ADDR & HIGH_20_MASK; vaddr < LOAD_ADDR + file_length; vaddr += ALIGNED_4KB)
+		if(map_zeroed_page(pg_dir, vaddr) == ERROR)
+			return ERROR;
 
-	buf[j] = '\0';
+	if(read_data(inode, 0, (void*)LOAD_ADDR, file_length) == ERROR)
+		return ERROR;
 
 	return 0;
-
 }
 
-
 /*
  * execute(const uint8_t* command)
- *   DESCRIPTION: Attempt to load and execute new program
+ *   DESCRIPTION: Attempt to load and execute new program. the caller sleeps
+ *                until the new program halts
  *   INPUTS: command to execute
  *   OUTPUTS: none
  *   RETURN VALUE: 0 if successful, ERROR if failed
- *   SIDE EFFECTS: Sets up kernel stack and creates a new PCB
+ *   SIDE EFFECTS: see do_execute
  */
 int32_t execute(const uint8_t* command) {
+	pcb_t* curr = this_rq()->curr_process;
+
+	if (curr == NULL)
+		return ERROR;
+
+	return do_execute(command, curr, curr->tid);
+}
+
+/*
+ * void init_user_frame(syscall_frame_t* frame, uint32_t entry_point, uint32_t user_esp)
+ *   DESCRIPTION: builds the frame syscall_return would leave through if a
+ *                program had made a system call right at its entry point
+ *   INPUTS: frame - top of a kernel stack
+ *           entry_point - first instruction of the program
+ *           user_esp - stack pointer left by push_exec_args
+ *   OUTPUTS: frame
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void init_user_frame(syscall_frame_t* frame, uint32_t entry_point, uint32_t user_esp) {
+	memset(frame, 0, sizeof(syscall_frame_t));
+	frame->eflags = EFLAGS_RESERVED;
+	frame->eip = entry_point;
+	frame->cs = USER_CS;
+	frame->user_eflags = EFLAGS_RESERVED | EFLAGS_IF;
+	frame->user_esp = user_esp;
+	frame->user_ss = USER_DS;
+}
+
+/*
+ * pcb_t* create_process(const uint8_t* command, pcb_t* parent, uint32_t tid,
+ *                       uint32_t foreground)
+ *   DESCRIPTION: loads the program named in command into a new address
+ *                space and sets up its pcb. if the program has a snapshot
+ *                the new process is a clone of that instead. shared by
+ *                execute, spawn and the boot shells
+ *   INPUTS: command to execute
+ *           parent, tid, foreground - see init_pcb
+ *   OUTPUTS: none
+ *   RETURN VALUE: the new pcb, NULL if failed
+ *   SIDE EFFECTS: leaves the new page directory loaded on success, and the
+ *                 frame the process enters user space with at USER_FRAME
+ */
+static pcb_t* create_process(const uint8_t* command, pcb_t* parent, uint32_t tid,
+							 uint32_t foreground) {
 	uint8_t filename[BUF_SIZE];
-	uint8_t args_buf[BUF_SIZE];
 	int32_t inode;
-	uint32_t filename_end, file_length, pid, stack_pointer, entry_point, esp, ebp, ret = 0, i = 0;
+	uint32_t filename_end, file_length, pid, entry_point, user_esp;
+	uint32_t* pg_dir;
 	pcb_t* pcb_addr;
+	snapshot_t* snap;
 
 	// fail if invalid command
 	if (command == NULL)
-        return ERROR;
+        return NULL;
 
 	// fail if cannot parse file name
 	if(get_file_name(command, filename, &filename_end) != 0)
-		return ERROR;
-
-	if(add_args_to_buf(args_buf, command, filename_end) != 0)
-		return ERROR;
+		return NULL;
 
 	if(validate_file(filename, &file_length, &inode) == ERROR)
-		return ERROR;
+		return NULL;
 
-	if((pid = get_available_pid()) == ERROR)
-	 	return ERROR;
+	// the environment is read out of the parent, before leaving its address space
+	if(parse_exec_args(command, &exec_args) == ERROR)
+		return NULL;
+	if(inherit_env(parent, &exec_args) == ERROR)
+		return NULL;
 
-	page_directory[EXEC_PG_DIR_OFFSET] = (ALIGNED_8MB + ALIGNED_4MB * pid) | EXEC_PG_DIR_FLAGS;
-	flush_tlb();
+	if((pid = get_available_pid()) == ERROR)
+	 	return NULL;
 
-	if(read_data(inode, 0, (void*)LOAD_ADDR, file_length) == ERROR)
-		return ERROR;
+	// give the new process its own address space and switch into it to load the image
+	pg_dir = init_proc_page_directory(pid);
+	load_page_directory(pg_dir);
 
-	if((entry_point = get_entry_point(inode)) == ERROR)
-		return ERROR;
+	pcb_addr = get_pcb(pid);
+	pcb_addr->page_dir = pg_dir;
+	pcb_addr->pid = pid;
+	pcb_addr->tid = tid;
+	strncpy(pcb_addr->filename, (const int8_t*)filename, MAX_STRING_LEN);
+
+	if((snap = snapshot_find(filename)) != NULL &&
+	   snapshot_clone(snap, pcb_addr, &exec_args) == ERROR) {
+		// these arguments don't fit in the snapshot's stack, start from the top
+		free_user_mappings(pg_dir);
+		load_page_directory(pg_dir);
+		snap = NULL;
+	}
+	if(snap == NULL) {
+		if(load_program(pg_dir, inode, file_length) == ERROR) {
+			free_user_mappings(pg_dir);
+			load_current_page_directory();
+			return NULL;
+		}
+
+		if((entry_point = get_entry_point(inode)) == ERROR) {
+			free_user_mappings(pg_dir);
+			load_current_page_directory();
+			return NULL;
+		}
+
+		if((user_esp = push_exec_args(pg_dir, pcb_addr, &exec_args)) == 0) {
+			free_user_mappings(pg_dir);
+			load_current_page_directory();
+			return NULL;
+		}
+
+		init_user_heap(pcb_addr);
+		init_user_frame(USER_FRAME(pid), entry_point, user_esp);
+	}
 
-	pcb_addr = (pcb_t*)(ALIGNED_8MB - ((pid+1) * ALIGNED_8KB));
+	if(init_pcb(pcb_addr, parent, tid, foreground) == ERROR) {
+		free_user_mappings(pg_dir);
+		load_current_page_directory();
+		return NULL;
+	}
+	if(snap != NULL)
+		snapshot_copy_files(snap, pcb_addr);
 
-	if(init_pcb(pcb_addr) == ERROR)
-		return ERROR;
-	
-	pcb_addr->pid = pid;
 	if(set_pid(pid) == ERROR)
-		return ERROR;
+		return NULL;
+
+	return pcb_addr;
+}
 
-	for(i = 0; i < strlen((const int8_t*)args_buf); ++i)
-		pcb_addr->args[i] = args_buf[i];
+/*
+ * do_execute(const uint8_t* command, pcb_t* parent, uint32_t tid)
+ *   DESCRIPTION: Attempt to load and execute new program
+ *   INPUTS: command to execute
+ *           parent - the calling process, or NULL to start the shell at
+ *                    the base of a terminal
+ *           tid - terminal the program runs on
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if successful, ERROR if failed
+ *   SIDE EFFECTS: Sets up kernel stack and creates a new PCB
+ */
+int32_t do_execute(const uint8_t* command, pcb_t* parent, uint32_t tid) {
+	uint32_t esp, ebp, ret = 0;
+	pcb_t* pcb_addr;
 
-	stack_pointer = ALIGNED_132MB - ALIGNED_4B; //132MB - 1 address
+	if((pcb_addr = create_process(command, parent, tid, 1)) == NULL)
+		return ERROR;
 
-	tss.ss0 = KERNEL_DS;
+	this_cpu()->tss->ss0 = KERNEL_DS;
 	if (num_processes > 0)
-		tss.esp0 = ALIGNED_8MB - (pid * ALIGNED_8KB) - ALIGNED_4B;
+		this_cpu()->tss->esp0 = KERNEL_STACK_TOP(pcb_addr->pid);
 
 
 	asm volatile (
@@ -273,36 +389,13 @@ int32_t execute(const uint8_t* command) {
 	pcb_addr->esp = esp;
 	pcb_addr->ebp = ebp;
 
+	// leave through the frame create_process built, like a forked child
 	asm volatile(
 		"cli;"
-		//set up ds register
-		"movw $0x2B, %%ax;"
-		"movw %%ax, %%ds;"
-		"movw %%ax, %%es;"
-		"movw %%ax, %%fs;"
-		"movw %%ax, %%gs;"
-		// "movw %%ax, %%ss;"
-
-		//push DS
-		"pushl $0x2B;"
-		//push ESP
-		"pushl %0;"
-
-		//need to set the IF flag because we cli'd
-		"pushfl;"
-		"popl %%eax;"
-		"orl $0x200, %%eax;"
-		//push EFLAGS
-		"pushl %%eax;"
-
-		//push CS
-		"pushl $0x23;"
-
-		//push EIP
-		"pushl %1;"
-		"iret;"
+		"movl %0, %%esp;"
+		"jmp ret_from_fork;"
 		:
-		: "m" (stack_pointer), "m" (entry_point)
+		: "r" (USER_FRAME(pcb_addr->pid))
 	);
 
 	asm volatile (
@@ -338,37 +431,59 @@ int32_t halt(uint8_t status) {
 	//save the status in a register. and use that register.
 	//this function is trippy
 	int32_t ret;
-	uint32_t esp, ebp, i;
+	uint32_t esp, ebp, i, tid, foreground;
+	pcb_t* parent;
 	ret = (int32_t)status;
 
-	pcb_t* finished_pcb = pcb_term[scheduler.curr_process->tid];
+	pcb_t* finished_pcb = this_rq()->curr_process;
 
 	if (finished_pcb == NULL)
-		ret = ERROR;
+		return ERROR;
 
 	esp = finished_pcb->esp;
 	ebp = finished_pcb->ebp;
+	tid = finished_pcb->tid;
+	parent = finished_pcb->parent;
 
     // close all fds in curr pcb
     for(i = 0; i < FD_ARRAY_MAX; i++){
         close(i);
     }
 
-	pcb_term[scheduler.curr_process->tid] = finished_pcb->parent;
+	// give back shared segments and the heap while the page directory is still loaded
+	shm_release_all(finished_pcb);
+	free_user_pages(finished_pcb);
 
-	free_pid(finished_pcb->pid);
-	remove_process_from_runqueue(&scheduler, finished_pcb);
+	// forked and spawned children are not the foreground process of their terminal
+	foreground = (pcb_term[tid] == finished_pcb);
+	if (foreground)
+		pcb_term[tid] = parent;
 
-    finished_pcb = finished_pcb->parent;
+	orphan_children(finished_pcb);
+	finished_pcb->exit_status = ret;
+	remove_process_from_runqueue(this_rq(), finished_pcb);
 	--num_processes;
 
-	if (finished_pcb == NULL)
-        execute((const uint8_t*)"shell");
+	// a child its parent did not wait for in execute keeps its pid as a
+	// zombie until the parent collects the status with waitpid
+	if (finished_pcb->parent_waiting || parent == NULL)
+		free_pid(finished_pcb->pid);
+	else
+		wake_up(&parent->child_wait);
+
+	if (finished_pcb->parent_waiting) {
+		load_page_directory(parent->page_dir);
+		this_cpu()->tss->ss0 = KERNEL_DS;
+		this_cpu()->tss->esp0 = KERNEL_STACK_TOP(parent->pid);
+	}
+	else if (foreground && parent == NULL)
+        do_execute((const uint8_t*)"shell", NULL, tid);
 	else {
-		page_directory[EXEC_PG_DIR_OFFSET] = (ALIGNED_8MB + ALIGNED_4MB * finished_pcb->pid) | EXEC_PG_DIR_FLAGS;
-		flush_tlb();
-		tss.ss0 = KERNEL_DS;
-		tss.esp0 = ALIGNED_8MB - (finished_pcb->pid * ALIGNED_8KB) - ALIGNED_4B;
+		// nobody is blocked in execute on this process, run something
+		// else. its stack is never switched back to, so this does not
+		// return, and whoever runs next turns interrupts back on
+		irq_save();
+		context_switch(finished_pcb, pick_next_task());
 	}
 
 	asm volatile (
@@ -383,6 +498,231 @@ int32_t halt(uint8_t status) {
 	return 0;
 }
 
+/*
+ * int32_t fork(void)
+ *   DESCRIPTION: Duplicates the calling process. the child gets a copy of
+ *                the pcb (fds, args, heap and shared memory) and shares
+ *                every user page copy on write. it starts out runnable and
+ *                returns from the same system call with 0
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the child's pid in the parent, ERROR on failure
+ *   SIDE EFFECTS: write protects the caller's private pages
+ */
+int32_t fork(void) {
+	pcb_t* parent = this_rq()->curr_process;
+	pcb_t* child;
+	uint32_t* pg_dir;
+	int32_t pid;
+	syscall_frame_t* child_frame;
+
+	if (parent == NULL)
+		return ERROR;
+
+	if ((pid = get_available_pid()) == ERROR)
+		return ERROR;
+
+	pg_dir = init_proc_page_directory(pid);
+	if (copy_user_pages(parent->page_dir, pg_dir) == ERROR) {
+		free_user_mappings(pg_dir);
+		load_page_directory(parent->page_dir);
+		return ERROR;
+	}
+	// our writable pages just became read only
+	load_page_directory(parent->page_dir);
+
+	child = get_pcb(pid);
+	memcpy(child, parent, sizeof(pcb_t));
+	child->pid = pid;
+	child->page_dir = pg_dir;
+	child->parent = parent;
+	child->parent_waiting = 0;
+	child->on_rq = 0;
+	wait_queue_init(&child->child_wait);
+	shm_fork(child);
+
+	// the child leaves through syscall_return with the parent's registers
+	child_frame = USER_FRAME(pid);
+	memcpy(child_frame, USER_FRAME(parent->pid), sizeof(syscall_frame_t));
+	child->curr_esp = (uint32_t)child_frame;
+	child->first_run = 1;
+
+	set_pid(pid);
+	num_processes++;
+	kstats.forks++;
+
+	// the parent keeps running, the child gets its first slice later
+	child->state = TASK_RUNNING;
+	sched_place(child);
+
+	return pid;
+}
+
+/*
+ * int32_t spawn(const uint8_t* command)
+ *   DESCRIPTION: starts a program as a child of the caller without waiting
+ *                for it. the child runs in the background on the caller's
+ *                terminal, its status is collected with waitpid
+ *   INPUTS: command to execute
+ *   OUTPUTS: none
+ *   RETURN VALUE: the child's pid, ERROR if failed
+ *   SIDE EFFECTS: creates a new PCB and puts it on the runqueue
+ */
+int32_t spawn(const uint8_t* command) {
+	pcb_t* curr = this_rq()->curr_process;
+	pcb_t* child;
+
+	if (curr == NULL)
+		return ERROR;
+
+	if ((child = create_process(command, curr, curr->tid, 0)) == NULL)
+		return ERROR;
+	load_page_directory(curr->page_dir);
+
+	child->curr_esp = (uint32_t)USER_FRAME(child->pid);
+	child->first_run = 1;
+
+	return child->pid;
+}
+
+/*
+ * int32_t boot_shell(uint32_t tid)
+ *   DESCRIPTION: starts the root shell of a terminal at boot. it is queued
+ *                like a spawned program and first runs when the scheduler
+ *                gets to it, so the boot does not wait on it
+ *   INPUTS: tid - terminal the shell belongs to
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if successful, ERROR if failed
+ *   SIDE EFFECTS: creates a new PCB and puts it on the runqueue
+ */
+int32_t boot_shell(uint32_t tid) {
+	pcb_t* shell;
+
+	if ((shell = create_process((const uint8_t*)"shell", NULL, tid, 0)) == NULL)
+		return ERROR;
+	load_current_page_directory();
+
+	// it owns the terminal, so halt restarts it like any root shell
+	pcb_term[tid] = shell;
+	terminals[tid].active = ACTIVE;
+
+	shell->curr_esp = (uint32_t)USER_FRAME(shell->pid);
+	shell->first_run = 1;
+
+	return 0;
+}
+
+/*
+ * int32_t exec(const uint8_t* command)
+ *   DESCRIPTION: replaces the image of the calling process with a new
+ *                program. pid, kernel stack, pcb, fds, parent and terminal
+ *                stay the same; memory, shared segments and vidmap do not.
+ *                snapshots are not used, they come with their own files
+ *   INPUTS: command to execute
+ *   OUTPUTS: none
+ *   RETURN VALUE: does not return on success, ERROR if the program cannot
+ *                 be found. if memory runs out after the old image is gone
+ *                 the process halts with status 255
+ *   SIDE EFFECTS: throws away the caller's address space
+ */
+int32_t exec(const uint8_t* command) {
+	pcb_t* curr = this_rq()->curr_process;
+	uint8_t filename[BUF_SIZE];
+	int32_t inode;
+	uint32_t filename_end, file_length, entry_point, user_esp;
+	syscall_frame_t* frame;
+
+	if (curr == NULL || command == NULL)
+		return ERROR;
+
+	// everything that can fail without side effects happens first
+	if(get_file_name(command, filename, &filename_end) != 0)
+		return ERROR;
+	if(validate_file(filename, &file_length, &inode) == ERROR)
+		return ERROR;
+	if((entry_point = get_entry_point(inode)) == ERROR)
+		return ERROR;
+	if(parse_exec_args(command, &exec_args) == ERROR)
+		return ERROR;
+	if(inherit_env(curr, &exec_args) == ERROR)
+		return ERROR;
+
+	// drop the old image, the cr3 reload flushes its tlb entries
+	shm_release_all(curr);
+	free_user_pages(curr);
+	curr->page_dir[VIDMAP_PG_DIR_OFFSET] = 0;
+	load_page_directory(curr->page_dir);
+
+	if(load_program(curr->page_dir, inode, file_length) == ERROR)
+		return halt((uint8_t)ERROR);
+
+	if((user_esp = push_exec_args(curr->page_dir, curr, &exec_args)) == 0)
+		return halt((uint8_t)ERROR);
+	init_user_heap(curr);
+	strncpy(curr->filename, (const int8_t*)filename, MAX_STRING_LEN);
+
+	// nothing on the kernel stack is needed anymore, start over at its top
+	frame = USER_FRAME(curr->pid);
+	init_user_frame(frame, entry_point, user_esp);
+	asm volatile (
+		"movl %0, %%esp;"
+		"jmp ret_from_fork;"
+		:
+		: "r" (frame)
+	);
+
+	return 0;
+}
+
+/*
+ * int32_t waitpid(int32_t pid, int32_t* status, int32_t options)
+ *   DESCRIPTION: waits for a child started with fork or spawn to halt and
+ *                frees its pid
+ *   INPUTS: pid - the child to wait for, or WAIT_ANY for any child
+ *           status - where the child's halt status is stored, may be NULL
+ *           options - WNOHANG to return right away if no child is done
+ *   OUTPUTS: status
+ *   RETURN VALUE: pid of the child that halted, ERROR if there is no such
+ *                 child or, with WNOHANG, if none of them has halted yet
+ *   SIDE EFFECTS: sleeps until a matching child halts
+ */
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options) {
+	pcb_t* curr = this_rq()->curr_process;
+	pcb_t* child;
+	uint32_t i, found;
+
+	if (curr == NULL)
+		return ERROR;
+	if (pid != WAIT_ANY && (pid < 0 || pid >= MAX_PROG_NUM))
+		return ERROR;
+	if (status != NULL && (!user_addr_ok(curr, (uint32_t)status) ||
+						   !user_addr_ok(curr, (uint32_t)(status + 1) - 1)))
+		return ERROR;
+
+	while (1) {
+		found = 0;
+		for (i = 0; i < MAX_PROG_NUM; i++) {
+			if (pid_arr[i] == PID_AVAILABLE || (pid != WAIT_ANY && pid != i))
+				continue;
+			child = get_pcb(i);
+			if (child == curr || child->parent != curr || child->parent_waiting)
+				continue;
+			found = 1;
+			if (child->state == TASK_ZOMBIE) {
+				if (status != NULL)
+					*status = child->exit_status;
+				free_pid(i);
+				return i;
+			}
+		}
+		if (!found || (options & WNOHANG))
+			return ERROR;
+
+		// halt wakes us when one of our children is done
+		sleep_on(&curr->child_wait);
+	}
+}
+
 /*
  * int32_t read(int32_t fd, void* buf, int32_t nbytes)
  *   DESCRIPTION: Read data from keyboard, file, RTC, or directory
@@ -402,10 +742,10 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes) {
 		return ERROR;
 
 	// check if this fd has not been opened yet
-	if((scheduler.curr_process->file_desc_array[fd].flags & IN_USE) == UNUSED)
+	if((this_rq()->curr_process->file_desc_array[fd].flags & IN_USE) == UNUSED)
 		return ERROR;
 
-	return scheduler.curr_process->file_desc_array[fd].file_op_table_ptr->read(fd, buf, nbytes);
+	return this_rq()->curr_process->file_desc_array[fd].file_op_table_ptr->read(fd, buf, nbytes);
 }
 
 /*
@@ -426,7 +766,7 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes) {
 	if(buf == NULL)
 		return ERROR;
 
-	file_desc_t file_desc = scheduler.curr_process->file_desc_array[fd];
+	file_desc_t file_desc = this_rq()->curr_process->file_desc_array[fd];
 
 	// check if this fd has not been opened yet
 	if((file_desc.flags & IN_USE) == UNUSED)
@@ -454,7 +794,7 @@ int32_t open(const uint8_t* filename) {
 	//check if the filename is valid
 	if (filename == NULL) return ERROR;
 	//check if there is room in the current PCB
-	pos = find_open_idx(scheduler.curr_process);
+	pos = find_open_idx(this_rq()->curr_process);
 	if (pos == ERROR) return ERROR;
 
 
@@ -495,8 +835,8 @@ int32_t open(const uint8_t* filename) {
 	file_desc_t fd = {file_op_table_ptr, inode, file_position, flags};
 
 	//add the file descriptor to the array
-	scheduler.curr_process->file_desc_array[pos] = fd;
-	scheduler.curr_process->capacity += 1;
+	this_rq()->curr_process->file_desc_array[pos] = fd;
+	this_rq()->curr_process->capacity += 1;
 	fd.file_op_table_ptr->open(filename);
 	return pos;
 }
@@ -519,16 +859,16 @@ int32_t close(int32_t fd) {
 	if(fd == STDIN_FD || fd == STDOUT_FD)
 		return ERROR;
 
-	file_desc_t file_desc = scheduler.curr_process->file_desc_array[fd];
+	file_desc_t file_desc = this_rq()->curr_process->file_desc_array[fd];
 
 	// check if this fd has not been opened yet
 	if((file_desc.flags & IN_USE) == UNUSED)
 		return ERROR;
 
 	// set the fd as not in use
-	scheduler.curr_process->file_desc_array[fd].flags &= ~IN_USE;
+	this_rq()->curr_process->file_desc_array[fd].flags &= ~IN_USE;
 
-	scheduler.curr_process->capacity--;
+	this_rq()->curr_process->capacity--;
 
 	return file_desc.file_op_table_ptr->close(fd);
 }
@@ -543,43 +883,80 @@ int32_t close(int32_t fd) {
  *   SIDE EFFECTS: writes to buf
  */
 int32_t getargs(uint8_t* buf, int32_t nbytes) {
-    uint32_t length;
-    
-    length = strlen(scheduler.curr_process->args);
-
-    if(buf == NULL)
-        return ERROR;
-
-	if(length + 1 > nbytes || length == 0)
+	if(buf == NULL)
 		return ERROR;
 
-	strcpy((int8_t*)buf, (const int8_t*)scheduler.curr_process->args);
-
-	return 0;
+	// argv[1..] joined by spaces, as it was typed minus extra blanks
+	return join_user_args(this_rq()->curr_process, buf, nbytes);
 }
 
 /*
  * int32_t vidmap(uint8_t** screen_start)
- *   DESCRIPTION: Maps the text-mode video memory into userspace at screen_start
+ *   DESCRIPTION: Maps the text-mode video memory into userspace at screen_start,
+ *                followed by the terminal's back buffer (see vid_flip)
  *   INPUTS: screen_start - address of pointer to start of video mem base address in user space
  *   OUTPUTS: memory of screen_start is updated with start of video memory in kernel space
  *   RETURN VALUE: virtual address of video memory
- *   SIDE EFFECTS: Sets up proper paging for video
+ *   SIDE EFFECTS: Sets up proper paging for video, fills the back buffer
+ *                 with what is on screen
  */
 int32_t vidmap(uint8_t** screen_start) {
-	if(screen_start == NULL)
+	pcb_t* curr = this_rq()->curr_process;
+	uint32_t flags;
+
+	if(screen_start == NULL || curr == NULL)
 		return ERROR;
-    if((uint32_t)screen_start < ALIGNED_128MB || (uint32_t)screen_start >= ALIGNED_132MB)
-        return ERROR;
+	// the pointer may live anywhere the program can write, its stack included
+	if(!user_addr_ok(curr, (uint32_t)screen_start) ||
+	   !user_addr_ok(curr, (uint32_t)(screen_start + 1) - 1))
+		return ERROR;
+
+    // the terminal's vidmap table already points at either video memory or
+    // the terminal's backup page (see switch_term), so only our pde changes
+    curr->page_dir[VIDMAP_PG_DIR_OFFSET] = ((uint32_t)vidmap_page_table_array[curr->tid]) | USER_SUPERVISOR | READ_WRITE | PRESENT;
+    flush_tlb_page(ALIGNED_132MB);
+    flush_tlb_page(ALIGNED_132MB + VIDMAP_BACK_OFFSET);
 
-    page_directory[VIDMAP_PG_DIR_OFFSET] = ((uint32_t)vidmap_page_table_array[curr_term_idx]) | USER_SUPERVISOR | READ_WRITE | PRESENT;
-    vidmap_page_table_array[curr_term_idx][0] = VID_MEM | READ_WRITE | USER_SUPERVISOR | PRESENT;
+    // so a program that only redraws what changed starts from the screen
+    flags = read_lock_irqsave(&screen_lock);
+    memcpy(terminals[curr->tid].back, term_front(curr->tid), ALIGNED_4KB);
+    read_unlock_irqrestore(&screen_lock, flags);
 
     *screen_start = (uint8_t*)ALIGNED_132MB;
 
     return ALIGNED_132MB;
 }
 
+/*
+ * int32_t vid_flip(int32_t sync)
+ *   DESCRIPTION: publishes the back buffer of the caller's terminal in one
+ *                copy, so a frame drawn there never shows half done. the
+ *                copy goes to video memory or, for a terminal that is not
+ *                on screen, to its backup page
+ *   INPUTS: sync - nonzero to wait for the next RTC interrupt first
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if vidmap was never called
+ *   SIDE EFFECTS: overwrites the terminal's screen
+ */
+int32_t vid_flip(int32_t sync) {
+	pcb_t* curr = this_rq()->curr_process;
+	uint32_t flags;
+
+	if (curr == NULL || !(curr->page_dir[VIDMAP_PG_DIR_OFFSET] & PRESENT))
+		return ERROR;
+
+	if (sync)
+		rtc_wait_tick();
+
+	// the terminal can't be switched mid copy
+	flags = read_lock_irqsave(&screen_lock);
+	memcpy(term_front(curr->tid), terminals[curr->tid].back, ALIGNED_4KB);
+	read_unlock_irqrestore(&screen_lock, flags);
+	kstats.vid_flips++;
+
+	return 0;
+}
+
 /*
  * int32_t set_handler(int32_t signum, void* handler_address)
  *   DESCRIPTION: ...
@@ -22,21 +22,45 @@
 #define ALIGNED_4B		0x4
 
 #define ALIGNED_8KB  0x2000
+
+#define WNOHANG         0x1
+
+#define EFLAGS_RESERVED 0x2
+#define EFLAGS_IF       0x200
 #define VIDMAP_MASK     0xFFFFE000
 
-#define EXEC_PG_DIR_FLAGS		 	(PAGE_SIZE_4MB | USER_SUPERVISOR | READ_WRITE | PRESENT)
-#define FIRST_PROG_PG_DIR_ENTRY		(ALIGNED_8MB | EXEC_PG_DIR_FLAGS)
-#define SECOND_PROG_PG_DIR_ENTRY 	(0x00C00000 | EXEC_PG_DIR_FLAGS)
 #define EXEC_PG_DIR_OFFSET 			32
 #define VIDMAP_PG_DIR_OFFSET 		33
+#define VIDMAP_BACK_OFFSET			ALIGNED_4KB
 #define EXEC_PG_OFFSET 				0x00048000
 #define LOAD_ADDR 					(0x08000000 | EXEC_PG_OFFSET)
 
 #define FIRST_PROG_PCB_ADDR         (ALIGNED_8MB - (1 * ALIGNED_8KB))
 #define SECOND_PROG_PCB_ADDR        (ALIGNED_8MB - (2 * ALIGNED_8KB))
+#define KERNEL_STACK_TOP(pid)       (ALIGNED_8MB - ((pid) * ALIGNED_8KB) - ALIGNED_4B)
 
 #define ERROR						-1
 
+/* what syscall_interrupt leaves at the top of the kernel stack, lowest address first */
+typedef struct syscall_frame_t
+{
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	uint32_t esi;
+	uint32_t edi;
+	uint32_t ebp;
+	uint32_t eflags;		//pushed by syscall_interrupt
+	uint32_t eip;			//everything from here on is pushed by the int instruction
+	uint32_t cs;
+	uint32_t user_eflags;
+	uint32_t user_esp;
+	uint32_t user_ss;
+} syscall_frame_t;
+
+/* the frame a process leaves its system calls through */
+#define USER_FRAME(pid)		((syscall_frame_t*)(KERNEL_STACK_TOP(pid) - sizeof(syscall_frame_t)))
+
 // extern uint32_t vidmap_page_table[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 
 // ================== OFFICIAL SYSTEM CALLS ===============================
@@ -56,17 +80,33 @@ int32_t close(int32_t fd);
 int32_t getargs(uint8_t* buf, int32_t nbytes);
 /* Maps the text-mode video memory into userspace at screen_start */
 int32_t vidmap(uint8_t** screen_start);
+/* Copies the vidmap back buffer to the screen */
+int32_t vid_flip(int32_t sync);
 /*discussed in signal section*/
 int32_t set_handler(int32_t signum, void* handler_address);
 /*discussed in signal section*/
 int32_t sigreturn(void);
 // ================== OFFICIAL SYSTEM CALLS ===============================
 
+/* Duplicates the calling process, sharing its pages copy on write */
+int32_t fork(void);
+/* Starts a program in the background and returns its pid */
+int32_t spawn(const uint8_t* command);
+/* Replaces the calling process's image with a new program */
+int32_t exec(const uint8_t* command);
+/* Waits for a forked or spawned child to halt */
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options);
+
+/* Loads command as a child of parent on terminal tid */
+int32_t do_execute(const uint8_t* command, pcb_t* parent, uint32_t tid);
+/* Queues the root shell of a terminal at boot */
+int32_t boot_shell(uint32_t tid);
+
 int32_t validate_file(const uint8_t* filename, uint32_t* file_length, int32_t *inode);
 int32_t get_file_name(const uint8_t* command, uint8_t* filename, uint32_t* filename_end);
 int32_t get_entry_point(uint32_t inode);
-int32_t add_args_to_buf(uint8_t* buf, const uint8_t* command, const uint32_t filename_end);
 void flush_tlb();
+void load_current_page_directory();
 
 extern uint32_t vidmap_term0[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
 extern uint32_t vidmap_term1[PG_DIR_TAB_SIZE] __attribute__((aligned (ALIGNED_4KB)));
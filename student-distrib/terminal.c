@@ -10,10 +10,20 @@
 #include "pcb.h"
 #include "sched.h"
 #include "systemcalls.h"
+#include "stats.h"
+#include "smp.h"
+
+/* one bit per terminal whose shell has asked for its first line */
+static uint32_t terms_ready;
+
+/* back buffers for vidmap. ordinary memory, so drawing into them never
+ * touches the vga and nothing shows until vid_flip copies them over */
+static char term_back[NUM_TERMS][ALIGNED_4KB] __attribute__((aligned (ALIGNED_4KB)));
 
 
 terminal_t terminals[NUM_TERMS];
 terminal_t* curr_term;
+rwlock_t screen_lock = RWLOCK_INIT("screen", LOCK_RANK_SCREEN);
 
 /*
  * void clear_terminal
@@ -100,7 +110,10 @@ void terminal_write_char(char key) {
  *   SIDE EFFECTS: None
  */
 int32_t terminal_write(int32_t fd, const void* in_buf, int32_t nbytes) {
-    int32_t i, ret = 0;
+    int32_t i, len, ret = 0;
+    uint32_t flags;
+    terminal_t* term;
+    char chunk[TERM_WRITE_CHUNK];
 
     // if stdin is calling it, call should fail
     if(fd == STDIN_FD){
@@ -108,20 +121,34 @@ int32_t terminal_write(int32_t fd, const void* in_buf, int32_t nbytes) {
     }
 
     // recast from void pointer
-    char* char_in_buf = (char*) in_buf;
-    for (i = 0; i < nbytes; i++) {
-        // terminal_write_char(char_in_buf[i]);
-
-		if(curr_term_idx == scheduler.curr_process->tid)
-        	putc_mod(char_in_buf[i]);
-		else{
-			/* write to proper backup buffer for
-			terminals[scheduler.head->tid].pte */
-            putc_page(char_in_buf[i], &(terminals[scheduler.curr_process->tid]));
-		}
-        ret++;
+    const char* char_in_buf = (const char*) in_buf;
+    term = &terminals[this_rq()->curr_process->tid];
+    while (ret < nbytes) {
+        // copy a chunk in before taking the locks, a fault on the user's
+        // buffer would hold up the keyboard handler on another cpu
+        len = nbytes - ret;
+        if (len > TERM_WRITE_CHUNK)
+            len = TERM_WRITE_CHUNK;
+        memcpy(chunk, char_in_buf + ret, len);
+
+        // each chunk lands on one side of a terminal switch. the keyboard
+        // handler echoes under the terminal lock, not the kernel lock
+        flags = read_lock_irqsave(&screen_lock);
+        spin_lock(&term->lock);
+        for (i = 0; i < len; i++) {
+            if(curr_term_idx == term->tid)
+                putc_mod(chunk[i]);
+            else{
+                /* write to proper backup buffer for
+                terminals[this_rq()->head->tid].pte */
+                putc_page(chunk[i], term);
+            }
+        }
+        update_cursor(get_screen_y(), get_screen_x());
+        spin_unlock(&term->lock);
+        read_unlock_irqrestore(&screen_lock, flags);
+        ret += len;
     }
-	update_cursor(get_screen_y(), get_screen_x());
 
     return ret;
 }
@@ -132,10 +159,12 @@ int32_t terminal_write(int32_t fd, const void* in_buf, int32_t nbytes) {
  *   INPUTS: id - terminal to switch to
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Switches to the terminal with same id
+ *   SIDE EFFECTS: Switches to the terminal with same id, waits for
+ *                 anything drawing on a screen to finish
  */
 void
 switch_term(uint32_t id){
+	uint32_t flags = write_lock_irqsave(&screen_lock);
 
 	// save vidmem to backup terminal
 	if(curr_term != NULL) {
@@ -147,14 +176,18 @@ switch_term(uint32_t id){
 	curr_term = &(terminals[id]);
 	curr_term_idx = id;
 
-	page_directory[VIDMAP_PG_DIR_OFFSET] = ((uint32_t)vidmap_page_table_array[curr_term_idx]) | USER_SUPERVISOR | READ_WRITE | PRESENT;
 	vidmap_page_table_array[curr_term_idx][0] = VID_MEM | READ_WRITE | USER_SUPERVISOR | PRESENT;
-	flush_tlb();
+	// only the vidmap page moved, and other address spaces get flushed by
+	// their next cr3 load, so drop just that entry. other cpus may be
+	// running with it cached too, and drop it when the IPI lands, see
+	// smp_flush_tlb_page
+	smp_flush_tlb_page(ALIGNED_132MB);
 
 	memcpy((char*) VID_MEM, curr_term->pte, ALIGNED_4KB);
 	set_screen_x(curr_term->x_loc);
 	set_screen_y(curr_term->y_loc);
 	update_cursor(curr_term->y_loc, curr_term->x_loc);
+	write_unlock_irqrestore(&screen_lock, flags);
 }
 
 
@@ -172,8 +205,17 @@ init_terms(){
     for(i = 0; i < NUM_TERMS; i++)
 	    init_terminal(i);
 
+	// terminal 0 starts out visible, the others draw into their backup pages
+	vidmap_page_table_array[0][0] = VID_MEM | READ_WRITE | USER_SUPERVISOR | PRESENT;
+	for(i = 1; i < NUM_TERMS; i++)
+		vidmap_page_table_array[i][0] = (uint32_t)(terminals[i].pte) | READ_WRITE | USER_SUPERVISOR | PRESENT;
+	// the back buffer sits right after the screen and never moves
+	for(i = 0; i < NUM_TERMS; i++)
+		vidmap_page_table_array[i][VIDMAP_BACK_OFFSET >> LOWER_12_BITS] = (uint32_t)(terminals[i].back) | READ_WRITE | USER_SUPERVISOR | PRESENT;
+
 	// curr_term = &(terminals[2]);
 	curr_term = &(terminals[0]);
+	curr_term_idx = 0;
 	curr_term->active = ACTIVE;
 	clear();
     set_screen_x(0);
@@ -195,9 +237,12 @@ init_terminal(uint32_t id){
 
 	terminal_t* term = &(terminals[id]);
     term->enter_flag = 0;
+	wait_queue_init(&term->read_wait);
+	spin_lock_init(&term->lock, "terminal", LOCK_RANK_TERM);
 	term->active = INACTIVE;
 	term->tid = id;
 	term->pte = (char*) term_pte[id];
+	term->back = term_back[id];
 	term->x_loc = 0;
 	term->y_loc = 0;
     term->auto_comp_index = 0;
@@ -208,4 +253,44 @@ init_terminal(uint32_t id){
 	term->buf_idx = 0;
     memset(term->buf, '\0', BUF_SIZE);
     memset(term->return_buffer, '\0', RET_BUF_SIZE);
+
+	// the backup page is what shows up on the first switch to this terminal
+	clear_page(term);
+	memcpy(term->back, term->pte, ALIGNED_4KB);
+}
+
+/*
+ * char* term_front(uint32_t tid)
+ *   DESCRIPTION: finds where terminal tid's screen lives right now
+ *   INPUTS: tid - terminal id
+ *   OUTPUTS: none
+ *   RETURN VALUE: video memory if tid is on screen, its backup page if not
+ *   SIDE EFFECTS: none
+ */
+char* term_front(uint32_t tid) {
+	if (&terminals[tid] == curr_term)
+		return (char*) VID_MEM;
+	return terminals[tid].pte;
+}
+
+/*
+ * void term_mark_ready(uint32_t tid)
+ *   DESCRIPTION: notes that a program on terminal tid is waiting for
+ *                input. once every terminal's shell got that far the boot
+ *                is done, and how long it took goes into kstats
+ *   INPUTS: tid - terminal being read
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets kstats.boot_ready_cycles/ticks the first time
+ */
+void
+term_mark_ready(uint32_t tid){
+	if(terms_ready & (1 << tid))
+		return;
+
+	terms_ready |= 1 << tid;
+	if(terms_ready == (1 << NUM_TERMS) - 1) {
+		kstats.boot_ready_cycles = rdtsc() - boot_tsc;
+		kstats.boot_ready_ticks = kstats.pit_ticks;
+	}
 }
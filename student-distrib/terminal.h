@@ -3,6 +3,8 @@
 
 #include "types.h"
 #include "keyboard.h"
+#include "wait_queue.h"
+#include "spinlock.h"
 
 #define USER_LINE	    ""
 
@@ -12,6 +14,7 @@
 #define INACTIVE        0
 #define ACTIVE          1
 #define NUM_PROG_TERM   4
+#define TERM_WRITE_CHUNK 128 //bytes terminal_write draws per hold of its locks
 
 
 /* Inits terminal */
@@ -28,6 +31,10 @@ void terminal_write_char(char key);	// helper for keyboard_write syscall
 
 /* Switch between 3 terminals */
 void switch_term(uint32_t id);
+/* Records that the shell on terminal tid is up and reading */
+void term_mark_ready(uint32_t tid);
+/* The page terminal tid is shown from, video memory or its backup */
+char* term_front(uint32_t tid);
 
 
 /* general struct for a file descriptor*/
@@ -35,6 +42,7 @@ typedef struct terminal_t
 {
     uint32_t tid;
     char* pte;
+    char* back;             //vidmap back buffer, published by vid_flip
 	int32_t x_loc, y_loc;
     uint32_t active;
     int auto_comp_index;
@@ -42,11 +50,15 @@ typedef struct terminal_t
     char cmd_history[HISTORY_SIZE][BUF_SIZE];
     int32_t buf_idx;
     uint32_t enter_flag;
+    wait_queue_t read_wait;     //terminal_read sleeps here until enter
+    spinlock_t lock;            //the keyboard handler against terminal_read/write
     char buf[BUF_SIZE];
     char return_buffer[RET_BUF_SIZE];
 } terminal_t;
 
 extern terminal_t terminals[NUM_TERMS];
 extern terminal_t* curr_term;
+/* read to draw on a terminal's screen, written to change which one shows */
+extern rwlock_t screen_lock;
 
 #endif /* _TERM_H */
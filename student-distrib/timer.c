@@ -0,0 +1,252 @@
+/* timer.c - Scheduler tick and timeouts on top of the local APIC or PIT
+ * vim:ts=4 noexpandtab
+ */
+
+#include "timer.h"
+#include "clock.h"
+#include "apic.h"
+#include "pit.h"
+#include "i8259.h"
+#include "sched.h"
+#include "stats.h"
+#include "lib.h"
+#include "smp.h"
+
+/* every interrupt is a one shot set for the next thing due: the end of
+ * the current tick while more than one task is runnable, else the first
+ * sleeper's deadline or TIMER_IDLE_US. time is read off the tsc clock, so
+ * it doesn't matter how early or late the timer fires, the tick counters
+ * are caught up to the clock each time. every cpu has its own local APIC
+ * timer and ticks on its own. the tick counters follow the boot cpu */
+static uint32_t timer_lapic;		//the local APIC times us, else the PIT
+static uint32_t timer_ticking[MAX_CPUS];	//armed for the end of a tick
+static uint64_t timer_last_tick[MAX_CPUS];	//clock_us each cpu's ticks are up to
+static pcb_t* sleepers;				//timer_sleep's processes, soonest first
+
+/*
+ * void timer_rearm(uint64_t now)
+ *   DESCRIPTION: sets the one shot for whatever is due next
+ *   INPUTS: now - current clock_us
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the local APIC timer or the PIT
+ */
+static void timer_rearm(uint64_t now) {
+	uint32_t cpu = smp_cpu_id();
+	uint32_t us;
+
+	timer_ticking[cpu] = (cpus[cpu].rq.size > 0);
+	if (timer_ticking[cpu])
+		us = SCHED_TICK_US - (uint32_t)(now - timer_last_tick[cpu]) % SCHED_TICK_US;
+	else
+		us = TIMER_IDLE_US;
+
+	if (sleepers != NULL) {
+		if (sleepers->wake_us <= now)
+			us = 1;
+		else if (sleepers->wake_us - now < us)
+			us = (uint32_t)(sleepers->wake_us - now);
+	}
+
+	if (timer_lapic)
+		lapic_timer_arm(us);
+	else
+		pit_arm(us);
+}
+
+/*
+ * uint32_t timer_account(uint64_t now)
+ *   DESCRIPTION: counts the whole ticks this cpu saw since the last call.
+ *                the boot cpu adds them to the tick counters
+ *   INPUTS: now - current clock_us
+ *   OUTPUTS: none
+ *   RETURN VALUE: ticks that passed
+ *   SIDE EFFECTS: updates pit_ticks, and idle_ticks if the idle task ran
+ */
+static uint32_t timer_account(uint64_t now) {
+	uint32_t cpu = smp_cpu_id();
+	runqueue_t * rq = &cpus[cpu].rq;
+	uint32_t ticks;
+
+	ticks = (uint32_t)(now - timer_last_tick[cpu]) / SCHED_TICK_US;
+	timer_last_tick[cpu] += ticks * SCHED_TICK_US;
+
+	if (cpu == 0) {
+		spin_lock(&stats_lock);
+		kstats.pit_ticks += ticks;
+		if (rq->curr_process == rq->idle)
+			kstats.idle_ticks += ticks;
+		spin_unlock(&stats_lock);
+	}
+	return ticks;
+}
+
+/*
+ * void timer_init(void)
+ *   DESCRIPTION: calibrates the tsc clock, then moves the scheduler tick
+ *                to the local APIC timer if the cpu has one. the PIT's
+ *                interrupt is masked then, it stays the timer otherwise
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: busy waits for the calibration, arms the first one shot
+ */
+void timer_init(void) {
+	clock_init();
+
+	if (lapic_init() == 0) {
+		timer_lapic = 1;
+		disable_irq(PIT_IRQ);
+	}
+
+	kstats.tsc_per_us = clock_tsc_per_us();
+	timer_last_tick[0] = clock_us();
+	timer_rearm(timer_last_tick[0]);
+}
+
+/*
+ * void timer_init_ap(void)
+ *   DESCRIPTION: starts an application processor's local APIC timer,
+ *                which timer_init already calibrated
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: arms the first one shot
+ */
+void timer_init_ap(void) {
+	uint32_t cpu = smp_cpu_id();
+
+	lapic_init_ap();
+	timer_last_tick[cpu] = clock_us();
+	timer_rearm(timer_last_tick[cpu]);
+}
+
+/*
+ * void timer_interrupt(void)
+ *   DESCRIPTION: the body of both timer interrupts. catches the tick
+ *                counters up, wakes sleepers that are due, charges the
+ *                running process and switches if it should give way
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the caller holds the kernel lock and has acknowledged
+ *                 the interrupt, a freshly forked process never comes back
+ *                 here
+ */
+void timer_interrupt(void) {
+	//upnext is the next process to run
+	pcb_t * up_next;
+	//current is the current process running
+	pcb_t * current;
+	pcb_t * p;
+	uint64_t now;
+	uint32_t ticks;
+
+	now = clock_us();
+	kstats.timer_irqs++;
+	ticks = timer_account(now);
+
+	while (sleepers != NULL && sleepers->wake_us <= now) {
+		p = sleepers;
+		sleepers = p->wait_next;
+		p->wait_next = NULL;
+		if (p->state == TASK_INTERRUPTIBLE)
+			sched_wake(p);
+	}
+
+	current = this_rq()->curr_process;
+	if (current == NULL) {
+		timer_rearm(now);
+		return;
+	}
+
+	//a quantum is only charged when a whole tick went by, an early
+	//interrupt for a sleeper just gives a woken task its chance
+	if (!(ticks ? sched_tick(current) : this_rq()->need_resched)) {
+		timer_rearm(now);
+		return;
+	}
+
+	//a system call we nested in switches on its way out, see sched_preempt
+	if (this_cpu()->lock_depth > 1) {
+		this_rq()->need_resched = 1;
+		timer_rearm(now);
+		return;
+	}
+
+	//the most urgent process that is running, or the idle task. the timer
+	//is set before switching, a forked child never comes back here
+	up_next = pick_next_task();
+	timer_rearm(now);
+	if (up_next == current) {
+		return;
+	}
+
+	context_switch(current, up_next);
+}
+
+/*
+ * void timer_need_ticks(void)
+ *   DESCRIPTION: called when a task becomes runnable next to the running
+ *                one. cuts a long one shot short, so quanta are timed
+ *                from here on
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reprograms the timer, must be called with interrupts off
+ */
+void timer_need_ticks(void) {
+	if (!timer_ticking[smp_cpu_id()])
+		timer_rearm(clock_us());
+}
+
+/*
+ * void timer_sleep(uint32_t us)
+ *   DESCRIPTION: blocks the current process until us microseconds have
+ *                passed. it goes in deadline order on the sleeper list,
+ *                and the timer is brought forward if it is now first
+ *   INPUTS: us - microseconds to sleep
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches processes, turns interrupts off meanwhile since
+ *                 the timer interrupt walks the list
+ */
+void timer_sleep(uint32_t us) {
+	pcb_t* current = this_rq()->curr_process;
+	pcb_t** it;
+	uint32_t flags = irq_save();
+	uint64_t now = clock_us();
+
+	current->wake_us = now + us;
+	for (it = &sleepers; *it != NULL && (*it)->wake_us <= current->wake_us;
+			it = &(*it)->wait_next)
+		;
+	current->wait_next = *it;
+	*it = current;
+	current->state = TASK_INTERRUPTIBLE;
+	kstats.timer_sleeps++;
+
+	if (sleepers == current)
+		timer_rearm(now);
+
+	sched_block();
+	irq_restore(flags);
+}
+
+/*
+ * int32_t usleep(uint32_t us)
+ *   DESCRIPTION: system call that sleeps for at least us microseconds,
+ *                without using the cpu meanwhile
+ *   INPUTS: us - microseconds to sleep
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if there is no process
+ *   SIDE EFFECTS: switches processes
+ */
+int32_t usleep(uint32_t us) {
+	if (this_rq()->curr_process == NULL)
+		return ERROR;
+
+	if (us > 0)
+		timer_sleep(us);
+	return 0;
+}
@@ -0,0 +1,33 @@
+/* timer.h - Scheduler tick and timeouts on top of the local APIC or PIT
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+#include "pit.h"
+
+/* length of the tick quanta and the tick counters are measured in */
+#define SCHED_TICK_US		(1000000 / HZ)
+/* longest one shot when nothing is runnable or due, so the counters and
+ * the mlfq boost still move along now and then */
+#define TIMER_IDLE_US		1000000
+
+#define ERROR				-1
+
+/* Starts the clock and the timer, the local APIC if there is one */
+void timer_init(void);
+/* Starts the timer of an application processor */
+void timer_init_ap(void);
+/* Accounts ticks, wakes sleepers and preempts, for whichever timer fired */
+void timer_interrupt(void);
+/* Goes back to timing quanta now that a second task wants the cpu */
+void timer_need_ticks(void);
+/* Puts the current process to sleep for us microseconds */
+void timer_sleep(uint32_t us);
+
+/* System call: sleeps for us microseconds */
+int32_t usleep(uint32_t us);
+
+#endif /* _TIMER_H */
@@ -0,0 +1,402 @@
+/* user_mem.c - Demand paged user memory and the page fault handler
+ * vim:ts=4 noexpandtab
+ */
+
+#include "user_mem.h"
+#include "frame_alloc.h"
+#include "paging_init.h"
+#include "sched.h"
+#include "stats.h"
+#include "lib.h"
+#include "smp.h"
+
+/*
+ * uint32_t* get_user_pte(uint32_t* pg_dir, uint32_t vaddr, int32_t create)
+ *   DESCRIPTION: walks pg_dir to the page table entry for vaddr. page tables
+ *                live in pool frames, which the kernel sees identity mapped
+ *   INPUTS: pg_dir - page directory to walk
+ *           vaddr - user virtual address
+ *           create - allocate the page table if it is missing
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the pte, NULL if there is none
+ *   SIDE EFFECTS: may allocate a zeroed page table
+ */
+uint32_t* get_user_pte(uint32_t* pg_dir, uint32_t vaddr, int32_t create) {
+	uint32_t pde_idx = vaddr >> PDE_SHIFT;
+	uint32_t table;
+
+	if (pg_dir == NULL || pde_idx < KERNEL_PG_DIR_ENTRIES)
+		return NULL;
+
+	if ((pg_dir[pde_idx] & PRESENT) == 0) {
+		if (!create)
+			return NULL;
+		if ((table = frame_alloc_zeroed()) == 0)
+			return NULL;
+		pg_dir[pde_idx] = table | USER_PAGE_FLAGS;
+	}
+
+	//4MB pages have no page table to walk
+	if (pg_dir[pde_idx] & PAGE_SIZE_4MB)
+		return NULL;
+
+	table = pg_dir[pde_idx] & HIGH_20_MASK;
+	return &((uint32_t*)table)[(vaddr >> LOWER_12_BITS) & PTE_INDEX_MASK];
+}
+
+/*
+ * int32_t map_zeroed_page(uint32_t* pg_dir, uint32_t vaddr)
+ *   DESCRIPTION: maps a zero filled frame at vaddr
+ *   INPUTS: pg_dir - page directory to map into
+ *           vaddr - page aligned user address that is not mapped yet
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if memory ran out
+ *   SIDE EFFECTS: allocates a frame (and maybe a page table)
+ */
+int32_t map_zeroed_page(uint32_t* pg_dir, uint32_t vaddr) {
+	uint32_t* pte;
+	uint32_t frame;
+
+	if ((pte = get_user_pte(pg_dir, vaddr, 1)) == NULL)
+		return ERROR;
+	if ((frame = frame_alloc_zeroed()) == 0)
+		return ERROR;
+	kstats.pages_zeroed++;
+
+	//the entry was not present before, so there is nothing to invalidate
+	*pte = frame | USER_PAGE_FLAGS;
+	return 0;
+}
+
+/*
+ * void free_empty_table(uint32_t* pg_dir, uint32_t pde_idx)
+ *   DESCRIPTION: frees the page table behind pg_dir[pde_idx] if nothing in
+ *                it is mapped anymore
+ *   INPUTS: pg_dir - page directory
+ *           pde_idx - entry to check
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may clear the pde and free the table
+ */
+static void free_empty_table(uint32_t* pg_dir, uint32_t pde_idx) {
+	uint32_t* table;
+	uint32_t i;
+
+	if ((pg_dir[pde_idx] & PRESENT) == 0 || (pg_dir[pde_idx] & PAGE_SIZE_4MB))
+		return;
+
+	table = (uint32_t*)(pg_dir[pde_idx] & HIGH_20_MASK);
+	for (i = 0; i < PG_DIR_TAB_SIZE; i++)
+		if (table[i] & PRESENT)
+			return;
+
+	pg_dir[pde_idx] = 0;
+	frame_free((uint32_t)table);
+}
+
+/*
+ * void unmap_user_range(uint32_t* pg_dir, uint32_t start, uint32_t end)
+ *   DESCRIPTION: unmaps all pages in [start, end) and drops their frames
+ *   INPUTS: pg_dir - page directory to unmap from
+ *           start, end - page aligned user addresses
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees frames and page tables that become empty
+ */
+void unmap_user_range(uint32_t* pg_dir, uint32_t start, uint32_t end) {
+	uint32_t vaddr, pde_idx;
+	uint32_t* pte;
+
+	for (vaddr = start; vaddr < end; vaddr += ALIGNED_4KB) {
+		pte = get_user_pte(pg_dir, vaddr, 0);
+		if (pte == NULL || (*pte & PRESENT) == 0)
+			continue;
+		frame_free(*pte & HIGH_20_MASK);
+		*pte = 0;
+		flush_tlb_page(vaddr);
+	}
+
+	for (pde_idx = start >> PDE_SHIFT; pde_idx <= (end - 1) >> PDE_SHIFT; pde_idx++)
+		free_empty_table(pg_dir, pde_idx);
+}
+
+/*
+ * void init_user_heap(pcb_t* pcb)
+ *   DESCRIPTION: gives a new process an empty heap
+ *   INPUTS: pcb - the new process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets the heap fields of the pcb
+ */
+void init_user_heap(pcb_t* pcb) {
+	pcb->heap_start = USER_HEAP_START;
+	pcb->brk = USER_HEAP_START;
+}
+
+/*
+ * void free_user_mappings(uint32_t* pg_dir)
+ *   DESCRIPTION: drops every 4KB user mapping and page table in pg_dir.
+ *                shared frames survive until their last owner lets go.
+ *                the caller switches address spaces afterwards, so the
+ *                tlb is flushed by that cr3 load
+ *   INPUTS: pg_dir - page directory that is going away
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the user pdes of pg_dir
+ */
+void free_user_mappings(uint32_t* pg_dir) {
+	uint32_t pde_idx, i;
+	uint32_t* table;
+
+	for (pde_idx = KERNEL_PG_DIR_ENTRIES; pde_idx < PG_DIR_TAB_SIZE; pde_idx++) {
+		//the vidmap tables are static and 4MB pages are not pool frames
+		if (pde_idx == VIDMAP_PG_DIR_OFFSET)
+			continue;
+		if ((pg_dir[pde_idx] & PRESENT) == 0 || (pg_dir[pde_idx] & PAGE_SIZE_4MB))
+			continue;
+		table = (uint32_t*)(pg_dir[pde_idx] & HIGH_20_MASK);
+		for (i = 0; i < PG_DIR_TAB_SIZE; i++)
+			if (table[i] & PRESENT)
+				frame_free(table[i] & HIGH_20_MASK);
+		frame_free((uint32_t)table);
+		pg_dir[pde_idx] = 0;
+	}
+}
+
+/*
+ * void free_user_pages(pcb_t* pcb)
+ *   DESCRIPTION: releases the image, stack and heap of a process. called
+ *                from halt before switching to another process
+ *   INPUTS: pcb - the process that is going away
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: see free_user_mappings, empties the heap
+ */
+void free_user_pages(pcb_t* pcb) {
+	free_user_mappings(pcb->page_dir);
+	pcb->brk = pcb->heap_start;
+}
+
+/*
+ * int32_t copy_user_pages(uint32_t* src, uint32_t* dst)
+ *   DESCRIPTION: gives dst the same user mappings as src without copying
+ *                any page. private writable pages become read only in both
+ *                directories and are marked PTE_COW, shared memory stays
+ *                writable. only the page tables themselves are copied
+ *   INPUTS: src - page directory of the process being forked
+ *           dst - fresh page directory of the child
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if memory ran out. on failure the
+ *                 caller cleans up dst with free_user_mappings
+ *   SIDE EFFECTS: write protects src, the caller must flush its tlb
+ */
+int32_t copy_user_pages(uint32_t* src, uint32_t* dst) {
+	uint32_t pde_idx, i, table;
+	uint32_t* src_table;
+	uint32_t* dst_table;
+
+	for (pde_idx = KERNEL_PG_DIR_ENTRIES; pde_idx < PG_DIR_TAB_SIZE; pde_idx++) {
+		if ((src[pde_idx] & PRESENT) == 0)
+			continue;
+		//the vidmap table is per terminal, not per process
+		if (pde_idx == VIDMAP_PG_DIR_OFFSET || (src[pde_idx] & PAGE_SIZE_4MB)) {
+			dst[pde_idx] = src[pde_idx];
+			continue;
+		}
+
+		if ((table = frame_alloc()) == 0)
+			return ERROR;
+		src_table = (uint32_t*)(src[pde_idx] & HIGH_20_MASK);
+		dst_table = (uint32_t*)table;
+
+		for (i = 0; i < PG_DIR_TAB_SIZE; i++) {
+			if ((src_table[i] & PRESENT) == 0) {
+				dst_table[i] = 0;
+				continue;
+			}
+			if ((src_table[i] & READ_WRITE) && (src_table[i] & PTE_SHARED) == 0)
+				src_table[i] = (src_table[i] & ~READ_WRITE) | PTE_COW;
+			frame_ref(src_table[i] & HIGH_20_MASK);
+			dst_table[i] = src_table[i];
+		}
+		dst[pde_idx] = table | USER_PAGE_FLAGS;
+	}
+	return 0;
+}
+
+/*
+ * int32_t cow_fault(uint32_t* pte, uint32_t vaddr)
+ *   DESCRIPTION: gives the faulting process its own writable copy of a copy
+ *                on write page. the last owner just gets write access back
+ *   INPUTS: pte - entry of the page that was written
+ *           vaddr - page aligned address of the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if memory ran out
+ *   SIDE EFFECTS: may allocate a frame and drop a reference on the old one
+ */
+static int32_t cow_fault(uint32_t* pte, uint32_t vaddr) {
+	uint32_t old_frame = *pte & HIGH_20_MASK;
+	uint32_t new_frame;
+
+	if (frame_refcount(old_frame) == 1) {
+		*pte = (*pte & ~PTE_COW) | READ_WRITE;
+	} else {
+		if ((new_frame = frame_alloc()) == 0)
+			return ERROR;
+		memcpy((void*)new_frame, (void*)old_frame, ALIGNED_4KB);
+		*pte = new_frame | USER_PAGE_FLAGS;
+		frame_free(old_frame);
+		kstats.cow_copies++;
+	}
+
+	flush_tlb_page(vaddr);
+	return 0;
+}
+
+/*
+ * int32_t unshare_user_page(uint32_t* pg_dir, uint32_t vaddr)
+ *   DESCRIPTION: makes a user page of pg_dir private and writable before
+ *                the kernel writes it. the page fault handler only does
+ *                this for the running process, which may not own pg_dir
+ *   INPUTS: pg_dir - page directory to change, must be the loaded one
+ *           vaddr - page aligned user address
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if memory ran out
+ *   SIDE EFFECTS: may map a zeroed page or copy a copy on write one
+ */
+int32_t unshare_user_page(uint32_t* pg_dir, uint32_t vaddr) {
+	uint32_t* pte = get_user_pte(pg_dir, vaddr, 0);
+
+	if (pte == NULL || (*pte & PRESENT) == 0)
+		return map_zeroed_page(pg_dir, vaddr);
+	if (*pte & PTE_COW)
+		return cow_fault(pte, vaddr);
+	return 0;
+}
+
+/*
+ * int32_t user_addr_ok(pcb_t* pcb, uint32_t addr)
+ *   DESCRIPTION: checks a user pointer before the kernel follows it. the
+ *                address has to be mapped or in a region that the page
+ *                fault handler fills in on demand
+ *   INPUTS: pcb - process whose address space is loaded
+ *           addr - user address
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the kernel may touch addr, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int32_t user_addr_ok(pcb_t* pcb, uint32_t addr) {
+	uint32_t* pte;
+
+	if (addr >= USER_IMAGE_START && addr < USER_IMAGE_END)
+		return 1;
+	if (addr >= USER_STACK_START && addr < USER_STACK_END)
+		return 1;
+	if (addr >= pcb->heap_start && addr < pcb->brk)
+		return 1;
+	if (addr < USER_IMAGE_START)
+		return 0;
+
+	//shared memory and vidmap are only reachable once mapped
+	pte = get_user_pte(pcb->page_dir, addr, 0);
+	return pte != NULL && (*pte & PRESENT) && (*pte & USER_SUPERVISOR);
+}
+
+/*
+ * int32_t page_fault_handler(uint32_t fault_addr, uint32_t error_code)
+ *   DESCRIPTION: resolves faults on pages that are allowed to exist but are
+ *                not backed yet (the image region, the stack and the heap
+ *                below the break) and writes to copy on write pages
+ *   INPUTS: fault_addr - the address in cr2
+ *           error_code - error code pushed by the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the faulting access can be retried, ERROR otherwise
+ *   SIDE EFFECTS: may map a zeroed or copied page
+ */
+int32_t page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
+	pcb_t* curr = this_rq()->curr_process;
+	uint32_t* pte;
+
+	kstats.page_faults++;
+
+	if (curr == NULL)
+		return ERROR;
+
+	//the only protection fault we resolve is a write to a copy on write page
+	if (error_code & PF_PRESENT) {
+		pte = get_user_pte(curr->page_dir, fault_addr, 0);
+		if ((error_code & PF_WRITE) && pte != NULL && (*pte & PTE_COW))
+			return cow_fault(pte, fault_addr & HIGH_20_MASK);
+		return ERROR;
+	}
+
+	if (fault_addr >= USER_IMAGE_START && fault_addr < USER_IMAGE_END)
+		return map_zeroed_page(curr->page_dir, fault_addr & HIGH_20_MASK);
+
+	//the stack grows down a page at a time, up to USER_STACK_MAX
+	if (fault_addr >= USER_STACK_START && fault_addr < USER_STACK_END)
+		return map_zeroed_page(curr->page_dir, fault_addr & HIGH_20_MASK);
+
+	if (fault_addr >= curr->heap_start && fault_addr < curr->brk)
+		return map_zeroed_page(curr->page_dir, fault_addr & HIGH_20_MASK);
+
+	return ERROR;
+}
+
+/*
+ * int32_t brk(void* addr)
+ *   DESCRIPTION: moves the end of the caller's heap. growing only moves the
+ *                break, pages are mapped and zeroed when they are touched.
+ *                shrinking frees the pages above the new break right away
+ *   INPUTS: addr - the new break
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, ERROR if addr is outside the heap region
+ *   SIDE EFFECTS: may unmap heap pages
+ */
+int32_t brk(void* addr) {
+	pcb_t* curr = this_rq()->curr_process;
+	uint32_t new_brk = (uint32_t)addr;
+	uint32_t* pte;
+
+	if (curr == NULL)
+		return ERROR;
+	if (new_brk < curr->heap_start || new_brk > USER_HEAP_END)
+		return ERROR;
+
+	if (new_brk < curr->brk) {
+		unmap_user_range(curr->page_dir, PAGE_ALIGN_UP(new_brk), PAGE_ALIGN_UP(curr->brk));
+
+		//the page holding the new break stays mapped, clear what was cut off
+		//so it reads back as zero if the heap grows again
+		pte = get_user_pte(curr->page_dir, new_brk, 0);
+		if ((new_brk & (ALIGNED_4KB - 1)) && pte != NULL && (*pte & PRESENT))
+			memset((void*)new_brk, 0, PAGE_ALIGN_UP(new_brk) - new_brk);
+	}
+
+	curr->brk = new_brk;
+	return 0;
+}
+
+/*
+ * int32_t sbrk(int32_t increment)
+ *   DESCRIPTION: grows or shrinks the caller's heap by increment bytes
+ *   INPUTS: increment - bytes to add (negative to give memory back)
+ *   OUTPUTS: none
+ *   RETURN VALUE: the old break on success, ERROR on failure
+ *   SIDE EFFECTS: see brk
+ */
+int32_t sbrk(int32_t increment) {
+	pcb_t* curr = this_rq()->curr_process;
+	uint32_t old_brk;
+
+	if (curr == NULL)
+		return ERROR;
+
+	old_brk = curr->brk;
+	if (increment > 0 && old_brk + increment < old_brk)
+		return ERROR;
+	if (brk((void*)(old_brk + increment)) == ERROR)
+		return ERROR;
+
+	return old_brk;
+}
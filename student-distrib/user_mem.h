@@ -0,0 +1,64 @@
+/* user_mem.h - Demand paged user memory and the page fault handler
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _USER_MEM_H
+#define _USER_MEM_H
+
+#include "types.h"
+#include "pcb.h"
+#include "systemcalls.h"
+
+/* the program image and its bss get the 4MB at 128MB. pages there that
+ * the image does not cover are mapped and zeroed when touched */
+#define USER_IMAGE_START	ALIGNED_128MB
+#define USER_IMAGE_END		ALIGNED_132MB
+
+/* the heap starts right above the vidmap page and grows up to 192MB */
+#define USER_HEAP_START		ALIGNED_136MB
+#define USER_HEAP_END		0x0C000000
+
+/* the stack has page tables of its own far above shared memory (see
+ * shm.h), and grows down from USER_STACK_END as pages are touched */
+#define USER_STACK_END		0x20000000
+#define USER_STACK_MAX		0x00800000
+#define USER_STACK_START	(USER_STACK_END - USER_STACK_MAX)
+
+#define USER_PAGE_FLAGS		(USER_SUPERVISOR | READ_WRITE | PRESENT)
+#define PAGE_ALIGN_UP(addr)	(((addr) + ALIGNED_4KB - 1) & HIGH_20_MASK)
+
+/* page fault error code bits */
+#define PF_PRESENT			0x1
+#define PF_WRITE			0x2
+#define PF_USER				0x4
+
+#define ERROR				-1
+
+/* Finds the pte mapping vaddr, optionally creating its page table */
+uint32_t* get_user_pte(uint32_t* pg_dir, uint32_t vaddr, int32_t create);
+/* Backs a single user page with a freshly zeroed frame */
+int32_t map_zeroed_page(uint32_t* pg_dir, uint32_t vaddr);
+/* Unmaps and frees every page in [start, end) */
+void unmap_user_range(uint32_t* pg_dir, uint32_t start, uint32_t end);
+/* Sets up an empty heap for a new process */
+void init_user_heap(pcb_t* pcb);
+/* Unmaps every user page and page table of a page directory */
+void free_user_mappings(uint32_t* pg_dir);
+/* Releases all demand paged memory of a process */
+void free_user_pages(pcb_t* pcb);
+/* Shares every user page of src with dst, copy on write */
+int32_t copy_user_pages(uint32_t* src, uint32_t* dst);
+/* Backs a user page or breaks its copy on write so the kernel can write it */
+int32_t unshare_user_page(uint32_t* pg_dir, uint32_t vaddr);
+/* Checks that the kernel can read addr on behalf of pcb */
+int32_t user_addr_ok(pcb_t* pcb, uint32_t addr);
+
+/* Called from page_fault_interrupt, returns 0 if the fault was resolved */
+int32_t page_fault_handler(uint32_t fault_addr, uint32_t error_code);
+
+/* Sets the end of the heap */
+int32_t brk(void* addr);
+/* Moves the end of the heap by increment bytes, returns the old end */
+int32_t sbrk(int32_t increment);
+
+#endif /* _USER_MEM_H */
@@ -0,0 +1,107 @@
+/* wait_queue.c - Lists of processes sleeping until an interrupt wakes them
+ * vim:ts=4 noexpandtab
+ */
+
+#include "wait_queue.h"
+#include "sched.h"
+#include "stats.h"
+#include "smp.h"
+
+/*
+ * void wait_queue_init(wait_queue_t* wq)
+ *   DESCRIPTION: empties a wait queue
+ *   INPUTS: wq - queue to clear
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void wait_queue_init(wait_queue_t* wq) {
+	wq->head = NULL;
+	spin_lock_init(&wq->lock, "wait queue", LOCK_RANK_WAIT);
+}
+
+/*
+ * void sleep_on(wait_queue_t* wq)
+ *   DESCRIPTION: blocks the current process until an interrupt handler
+ *                calls wake_up on wq. the scheduler skips it meanwhile, so
+ *                waiting costs no cpu. callers recheck their condition,
+ *                since one wake_up releases every sleeper. only for events
+ *                raised under the kernel lock, which the caller holds
+ *                between checking and sleeping, see sleep_on_unlock
+ *   INPUTS: wq - queue to sleep on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches processes, with interrupts off
+ */
+void sleep_on(wait_queue_t* wq) {
+	pcb_t* current = this_rq()->curr_process;
+	uint32_t flags;
+
+	flags = spin_lock_irqsave(&wq->lock);
+	current->wait_next = wq->head;
+	wq->head = current;
+	current->state = TASK_INTERRUPTIBLE;
+	spin_unlock(&wq->lock);
+	kstats.wait_sleeps++;
+
+	sched_block();
+	irq_restore(flags);
+}
+
+/*
+ * void sleep_on_unlock(wait_queue_t* wq, spinlock_t* lock)
+ *   DESCRIPTION: sleep_on for events raised by handlers that don't take
+ *                the kernel lock. the caller checked its condition under
+ *                lock, and we are on wq before letting go of it, so a
+ *                handler that changes the condition under lock and then
+ *                wakes wq can't slip in between. a wake up that comes
+ *                before sched_block just leaves us running
+ *   INPUTS: wq - queue to sleep on
+ *           lock - held lock guarding the condition, taken without
+ *                  saving flags
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches processes, releases lock without taking it
+ *                 back, must be called with interrupts off
+ */
+void sleep_on_unlock(wait_queue_t* wq, spinlock_t* lock) {
+	pcb_t* current = this_rq()->curr_process;
+
+	spin_lock(&wq->lock);
+	current->wait_next = wq->head;
+	wq->head = current;
+	current->state = TASK_INTERRUPTIBLE;
+	spin_unlock(&wq->lock);
+	spin_unlock(lock);
+	kstats.wait_sleeps++;
+
+	sched_block();
+}
+
+/*
+ * void wake_up(wait_queue_t* wq)
+ *   DESCRIPTION: makes every process sleeping on wq runnable, on the top
+ *                scheduler level. the list is taken off wq under its lock
+ *                and woken after, so no run queue lock is taken inside it
+ *   INPUTS: wq - queue to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: empties wq, meant for interrupt handlers
+ */
+void wake_up(wait_queue_t* wq) {
+	pcb_t* it;
+	pcb_t* next;
+	uint32_t flags;
+
+	flags = spin_lock_irqsave(&wq->lock);
+	it = wq->head;
+	wq->head = NULL;
+	spin_unlock_irqrestore(&wq->lock, flags);
+	while (it != NULL) {
+		next = it->wait_next;
+		it->wait_next = NULL;
+		if (it->state == TASK_INTERRUPTIBLE)
+			sched_wake(it);
+		it = next;
+	}
+}
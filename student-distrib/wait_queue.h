@@ -0,0 +1,30 @@
+/* wait_queue.h - Lists of processes sleeping until an interrupt wakes them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "types.h"
+#include "spinlock.h"
+
+struct pcb_t;
+
+/* the processes sleeping on one event, linked through pcb_t.wait_next.
+ * the lock lets interrupt handlers outside the kernel lock wake them */
+typedef struct wait_queue_t
+{
+	struct pcb_t* head;
+	spinlock_t lock;
+} wait_queue_t;
+
+/* Empties a wait queue */
+void wait_queue_init(wait_queue_t* wq);
+/* Puts the current process to sleep on wq until wake_up */
+void sleep_on(wait_queue_t* wq);
+/* The same, dropping the lock that guards the condition slept on */
+void sleep_on_unlock(wait_queue_t* wq, spinlock_t* lock);
+/* Makes every process sleeping on wq runnable again */
+void wake_up(wait_queue_t* wq);
+
+#endif /* _WAIT_QUEUE_H */
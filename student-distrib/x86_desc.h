@@ -16,6 +16,13 @@
 #define USER_DS 0x002B
 #define KERNEL_TSS 0x0030
 #define KERNEL_LDT 0x0038
+/* each application processor has its own TSS, in the GDT after the LDT.
+ * the boot cpu keeps KERNEL_TSS */
+#define AP_TSS_BASE 0x0040
+#define CPU_TSS(cpu) ((cpu) ? AP_TSS_BASE + (((cpu) - 1) << 3) : KERNEL_TSS)
+
+/* Most processors the kernel brings up */
+#define MAX_CPUS 4
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE 104
@@ -124,13 +131,22 @@ extern uint32_t ldt;
 
 extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
+extern seg_desc_t ap_tss_desc_ptr[MAX_CPUS - 1];
 extern tss_t tss;
 
 /* Interrupt handlers for devices */
 extern void rtc_interrupt();
 extern void keyboard_interrupt();
 extern void pit_interrupt();
+extern void lapic_timer_interrupt();
+extern void lapic_spurious_interrupt();
+extern void resched_ipi_interrupt();
+extern void tlb_ipi_interrupt();
 extern void syscall_interrupt();
+extern void page_fault_interrupt();
+
+/* Returns a freshly forked child to user space (see fork) */
+extern void ret_from_fork();
 
 
 /* Small code to push and pop all registers (including flags) */
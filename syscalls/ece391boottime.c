@@ -0,0 +1,30 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Reports how long the kernel took from being entered until the shell on
+ * every terminal was up and waiting for input.  Both numbers stay zero
+ * until all of the shells got that far.  The tsc count wraps after a few
+ * seconds, the PIT tick count does not.
+ */
+
+int main ()
+{
+    ece391_stats_t stats;
+
+    if (-1 == ece391_getstats (&stats, sizeof (stats))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read kernel stats.\n");
+        return 3;
+    }
+    if (0 == stats.boot_ready_ticks && 0 == stats.boot_ready_cycles) {
+        ece391_fdputs (1, (uint8_t*)"Not every shell is up yet.\n");
+        return 2;
+    }
+
+    ece391_fdputu (1, (uint8_t*)"boot to shells ready, cycles: ", stats.boot_ready_cycles);
+    ece391_fdputu (1, (uint8_t*)"boot to shells ready, ticks:  ", stats.boot_ready_ticks);
+
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Prints the argument and environment vectors the program was started
+ * with, one string per line.  "env a b" shows argc 3; the environment is
+ * whatever the shell that ran it was given.
+ */
+
+int main (int argc, char** argv, char** envp)
+{
+    int32_t i;
+
+    ece391_fdputu (1, (uint8_t*)"argc: ", argc);
+    for (i = 0; i < argc; i++) {
+        ece391_fdputs (1, (uint8_t*)"argv: ");
+        ece391_fdputs (1, (uint8_t*)argv[i]);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    for (i = 0; envp[i] != 0; i++) {
+        ece391_fdputs (1, (uint8_t*)"envp: ");
+        ece391_fdputs (1, (uint8_t*)envp[i]);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
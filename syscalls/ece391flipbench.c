@@ -0,0 +1,71 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Compares drawing a frame straight into video memory with drawing it
+ * into the vidmap back buffer and publishing it with vid_flip.  Each of
+ * ROUNDS frames rewrites every cell of the screen one byte at a time, the
+ * way a program redrawing scattered characters would.  The direct writes
+ * all go to the vga, the buffered ones go to ordinary memory and reach
+ * the vga in a single copy.  The screen is left with the last frame.
+ */
+
+#define ROUNDS       32
+#define NUM_COLS     80
+#define NUM_ROWS     25
+#define ATTRIB       0x0A
+
+static void draw_frame (uint8_t* screen, uint32_t frame)
+{
+    uint32_t i;
+
+    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
+        screen[i << 1] = 'A' + (i + frame) % 26;
+        screen[(i << 1) + 1] = ATTRIB;
+    }
+}
+
+int main ()
+{
+    ece391_stats_t before, after;
+    uint8_t* screen;
+    uint8_t* back;
+    uint32_t direct_cycles = 0, draw_cycles = 0, flip_cycles = 0;
+    uint32_t t0, t1, i;
+
+    if (-1 == ece391_vidmap (&screen)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 2;
+    }
+    back = screen + ECE391_VID_BACK_OFFSET;
+
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        draw_frame (screen, i);
+        direct_cycles += ece391_rdtsc () - t0;
+    }
+
+    ece391_getstats (&before, sizeof (before));
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        draw_frame (back, i);
+        t1 = ece391_rdtsc ();
+        if (-1 == ece391_vid_flip (0)) {
+            ece391_fdputs (1, (uint8_t*)"vid_flip failed\n");
+            return 3;
+        }
+        draw_cycles += t1 - t0;
+        flip_cycles += ece391_rdtsc () - t1;
+    }
+    ece391_getstats (&after, sizeof (after));
+
+    ece391_fdputu (1, (uint8_t*)"flips:                      ", after.vid_flips - before.vid_flips);
+    ece391_fdputu (1, (uint8_t*)"cycles per direct frame:    ", direct_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per back buffer draw:", draw_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per flip:            ", flip_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per buffered frame:  ", (draw_cycles + flip_cycles) / ROUNDS);
+
+    return 0;
+}
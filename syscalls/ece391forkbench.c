@@ -0,0 +1,77 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Compares creating a process with fork against executing the same
+ * program.  "forkbench" forks ROUNDS children that halt right away, then
+ * runs "forkbench child" (which returns right away) ROUNDS times through
+ * execute, and reports the average cycles of each.  fork+exit is timed
+ * from the fork call until waitpid has collected the child, which is the
+ * same span execute covers.  A heap of HEAP_PAGES is touched first so fork
+ * has pages to share, and the parent writes one of them after each fork
+ * to time a copy on write fault (left out of the fork+exit time).  Run it
+ * with nothing else busy, or the other tasks' slices get counted too.
+ */
+
+#define ROUNDS       16
+#define HEAP_PAGES   32
+#define PAGE_SIZE    4096
+#define BUFSIZE      32
+
+int main ()
+{
+    ece391_stats_t before, after;
+    uint8_t buf[BUFSIZE];
+    uint8_t* heap;
+    uint32_t fork_cycles = 0, exit_cycles = 0, cow_cycles = 0, exec_cycles = 0;
+    uint32_t t0, t1, t2, i;
+    int32_t pid;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) &&
+        0 == ece391_strcmp (buf, (uint8_t*)"child"))
+        return 0;
+
+    if ((void*)-1 == (heap = ece391_sbrk (HEAP_PAGES * PAGE_SIZE))) {
+        ece391_fdputs (1, (uint8_t*)"Can't grow the heap.\n");
+        return 2;
+    }
+    for (i = 0; i < HEAP_PAGES; i++)
+        heap[i * PAGE_SIZE] = 1;
+
+    ece391_getstats (&before, sizeof (before));
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        if (-1 == (pid = ece391_fork ())) {
+            ece391_fdputs (1, (uint8_t*)"fork failed\n");
+            return 3;
+        }
+        if (0 == pid)
+            ece391_halt (0);
+        t1 = ece391_rdtsc ();
+        heap[(i % HEAP_PAGES) * PAGE_SIZE] = (uint8_t)i;
+        t2 = ece391_rdtsc ();
+        ece391_waitpid (pid, 0, 0);
+
+        fork_cycles += t1 - t0;
+        cow_cycles += t2 - t1;
+        exit_cycles += (t1 - t0) + (ece391_rdtsc () - t2);
+    }
+    ece391_getstats (&after, sizeof (after));
+
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        ece391_execute ((uint8_t*)"forkbench child");
+        exec_cycles += ece391_rdtsc () - t0;
+    }
+
+    ece391_fdputu (1, (uint8_t*)"forks:                ", after.forks - before.forks);
+    ece391_fdputu (1, (uint8_t*)"cow pages copied:     ", after.cow_copies - before.cow_copies);
+    ece391_fdputu (1, (uint8_t*)"cycles per fork:      ", fork_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per fork+exit: ", exit_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per cow fault: ", cow_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per execute:   ", exec_cycles / ROUNDS);
+
+    return 0;
+}
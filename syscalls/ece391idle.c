@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows how much of the machine sits idle while programs wait for input.
+ * "idle" sleeps through TICKS RTC interrupts at RTC_RATE Hz and reports
+ * how many PIT ticks in that span found no runnable process.  With the
+ * other terminals at their shell prompts that should be nearly all of
+ * them; anything still running in the background shows up as the gap.
+ */
+
+#define RTC_RATE     32
+#define TICKS        64
+
+int main ()
+{
+    ece391_stats_t before, after;
+    int32_t rtc_fd, rate = RTC_RATE, garbage;
+    uint32_t i, ticks, idle;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"Can't open the rtc.\n");
+        return 2;
+    }
+    ece391_write (rtc_fd, &rate, 4);
+
+    ece391_getstats (&before, sizeof (before));
+    for (i = 0; i < TICKS; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_getstats (&after, sizeof (after));
+    ece391_close (rtc_fd);
+
+    ticks = after.pit_ticks - before.pit_ticks;
+    idle = after.idle_ticks - before.idle_ticks;
+
+    ece391_fdputu (1, (uint8_t*)"pit ticks:     ", ticks);
+    ece391_fdputu (1, (uint8_t*)"idle ticks:    ", idle);
+    ece391_fdputu (1, (uint8_t*)"percent idle:  ", ticks ? idle * 100 / ticks : 0);
+    ece391_fdputu (1, (uint8_t*)"sleeps:        ", after.wait_sleeps - before.wait_sleeps);
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Reports the longest stretch any scheduling cpu has kept interrupts off
+ * since boot, which bounds how late an interrupt can be taken.  Before
+ * reading it, "irqoff" gives the usual suspects a turn: it touches
+ * HEAP_PAGES fresh heap pages so the idle task has zero pool frames to
+ * make up, writes LINES lines to the terminal and waits out TICKS RTC
+ * interrupts while the pool refills.  With a LOCK_DEBUG kernel it also
+ * shows how many times locks were taken out of order.
+ */
+
+#define HEAP_PAGES   32
+#define PAGE_SIZE    4096
+#define LINES        8
+#define RTC_RATE     32
+#define TICKS        16
+
+int main ()
+{
+    ece391_stats_t stats;
+    uint8_t* heap;
+    int32_t rtc_fd, rate = RTC_RATE, garbage;
+    uint32_t i;
+
+    if ((void*)-1 == (heap = ece391_sbrk (HEAP_PAGES * PAGE_SIZE))) {
+        ece391_fdputs (1, (uint8_t*)"Can't grow the heap.\n");
+        return 2;
+    }
+    for (i = 0; i < HEAP_PAGES; i++)
+        heap[i * PAGE_SIZE] = 1;
+
+    for (i = 0; i < LINES; i++)
+        ece391_fdputs (1, (uint8_t*)"the quick brown fox jumps over the lazy dog\n");
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"Can't open the rtc.\n");
+        return 2;
+    }
+    ece391_write (rtc_fd, &rate, 4);
+    for (i = 0; i < TICKS; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_close (rtc_fd);
+
+    ece391_getstats (&stats, sizeof (stats));
+
+    ece391_fdputu (1, (uint8_t*)"max irqs off cycles:   ", stats.irq_off_max_cycles);
+    if (0 != stats.tsc_per_us)
+        ece391_fdputu (1, (uint8_t*)"max irqs off us:       ", stats.irq_off_max_cycles / stats.tsc_per_us);
+    ece391_fdputu (1, (uint8_t*)"lock order violations: ", stats.lock_order_violations);
+
+    return 0;
+}
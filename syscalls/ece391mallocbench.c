@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Exercises the support library allocator.  Times ROUNDS malloc/free
+ * pairs of a small size (served from a size class list), growing a buffer
+ * byte by byte with realloc, and filling an arena, then prints the
+ * allocator's counters.  Nothing should be in use at the end.
+ */
+
+#define ROUNDS       1024
+#define SMALL_SIZE   48
+#define GROW_TO      16384
+#define ARENA_SIZE   8192
+
+int main ()
+{
+    ece391_malloc_stats_t stats;
+    ece391_arena_t arena;
+    uint8_t* buf = 0;
+    uint8_t* tmp;
+    uint32_t t0, pair_cycles, grow_cycles, arena_cycles, i, n;
+
+    t0 = ece391_rdtsc ();
+    for (i = 0; i < ROUNDS; i++)
+        ece391_free (ece391_malloc (SMALL_SIZE));
+    pair_cycles = ece391_rdtsc () - t0;
+
+    t0 = ece391_rdtsc ();
+    for (i = 1; i <= GROW_TO; i++) {
+        if (0 == (tmp = ece391_realloc (buf, i))) {
+            ece391_fdputs (1, (uint8_t*)"realloc failed\n");
+            return 2;
+        }
+        buf = tmp;
+        buf[i - 1] = (uint8_t)i;
+    }
+    grow_cycles = ece391_rdtsc () - t0;
+    ece391_free (buf);
+
+    if (-1 == ece391_arena_init (&arena, ARENA_SIZE)) {
+        ece391_fdputs (1, (uint8_t*)"arena failed\n");
+        return 2;
+    }
+    t0 = ece391_rdtsc ();
+    for (n = 0; 0 != ece391_arena_alloc (&arena, SMALL_SIZE); n++);
+    arena_cycles = ece391_rdtsc () - t0;
+    ece391_arena_destroy (&arena);
+
+    ece391_malloc_stats (&stats);
+    ece391_fdputu (1, (uint8_t*)"cycles per malloc+free:  ", pair_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per realloc:      ", grow_cycles / GROW_TO);
+    ece391_fdputu (1, (uint8_t*)"cycles per arena alloc:  ", arena_cycles / n);
+    ece391_fdputu (1, (uint8_t*)"mallocs:                 ", stats.mallocs);
+    ece391_fdputu (1, (uint8_t*)"frees:                   ", stats.frees);
+    ece391_fdputu (1, (uint8_t*)"reallocs that moved:     ", stats.reallocs);
+    ece391_fdputu (1, (uint8_t*)"bytes in use:            ", stats.bytes_in_use);
+    ece391_fdputu (1, (uint8_t*)"peak bytes in use:       ", stats.peak_bytes_in_use);
+    ece391_fdputu (1, (uint8_t*)"heap bytes:              ", stats.heap_bytes);
+    ece391_fdputu (1, (uint8_t*)"sbrk calls:              ", stats.sbrk_calls);
+
+    return 0;
+}
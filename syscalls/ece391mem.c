@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows who holds memory: free and total physical frames, shared memory
+ * and snapshot usage, then one block per live process with the pages it
+ * has mapped by region.  Pages are 4 kB.
+ */
+
+static const char* state_names[] = {
+    "running", "interruptible", "uninterruptible", "stopped", "zombie", "sleeping"
+};
+
+static void put_int (const char* label, int32_t value)
+{
+    if (value >= 0) {
+        ece391_fdputu (1, (uint8_t*)label, value);
+        return;
+    }
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, (uint8_t*)"none\n");
+}
+
+int main ()
+{
+    ece391_meminfo_t info;
+    ece391_proc_mem_t* p;
+    uint32_t i;
+
+    if (-1 == ece391_meminfo (&info, sizeof (info))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read memory info.\n");
+        return 3;
+    }
+
+    ece391_fdputu (1, (uint8_t*)"frames total:    ", info.total_frames);
+    ece391_fdputu (1, (uint8_t*)"frames free:     ", info.free_frames);
+    ece391_fdputu (1, (uint8_t*)"  of them zeroed:", info.zeroed_frames);
+    ece391_fdputu (1, (uint8_t*)"processes:       ", info.processes);
+    ece391_fdputu (1, (uint8_t*)"shm segments:    ", info.shm_segments);
+    ece391_fdputu (1, (uint8_t*)"shm pages:       ", info.shm_pages);
+    ece391_fdputu (1, (uint8_t*)"snapshots:       ", info.snapshots);
+    ece391_fdputu (1, (uint8_t*)"snapshot pages:  ", info.snapshot_pages);
+
+    for (i = 0; i < ECE391_MAX_PROCS; i++) {
+        p = &info.procs[i];
+        if (ECE391_NO_PID == p->pid)
+            continue;
+        ece391_fdputu (1, (uint8_t*)"\npid ", p->pid);
+        ece391_fdputs (1, (uint8_t*)"  state:        ");
+        ece391_fdputs (1, (uint8_t*)(p->state < 6 ? state_names[p->state] : "?"));
+        ece391_fdputs (1, (uint8_t*)"\n");
+        put_int ("  parent:       ", p->parent);
+        ece391_fdputu (1, (uint8_t*)"  terminal:     ", p->tid);
+        ece391_fdputu (1, (uint8_t*)"  image pages:  ", p->image_pages);
+        ece391_fdputu (1, (uint8_t*)"  stack pages:  ", p->stack_pages);
+        ece391_fdputu (1, (uint8_t*)"  heap pages:   ", p->heap_pages);
+        ece391_fdputu (1, (uint8_t*)"  shm pages:    ", p->shm_pages);
+        ece391_fdputu (1, (uint8_t*)"  shared pages: ", p->shared_pages);
+        ece391_fdputu (1, (uint8_t*)"  page tables:  ", p->page_tables);
+        ece391_fdputu (1, (uint8_t*)"  kernel bytes: ", p->kernel_bytes);
+    }
+
+    return 0;
+}
@@ -4,14 +4,32 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define NUMSIZE 11
+
+/* report background jobs that finished since the last prompt */
+static void reap_jobs (int32_t options)
+{
+    int32_t pid, status;
+    uint8_t num[NUMSIZE];
+
+    while (-1 != (pid = ece391_waitpid (ECE391_WAIT_ANY, &status, options))) {
+        ece391_fdputs (1, (uint8_t*)"[");
+        ece391_fdputs (1, ece391_itoa (pid, num, 10));
+        ece391_fdputs (1, (uint8_t*)"] done, status ");
+        ece391_fdputs (1, ece391_itoa (status, num, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, background;
     uint8_t buf[BUFSIZE];
+    uint8_t num[NUMSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        reap_jobs (ECE391_WNOHANG);
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -22,8 +40,37 @@ int main ()
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
+	/* "cmd &" runs cmd in the background */
+	while (cnt > 0 && ' ' == buf[cnt - 1])
+	    buf[--cnt] = '\0';
+	background = (cnt > 0 && '&' == buf[cnt - 1]);
+	if (background) {
+	    buf[--cnt] = '\0';
+	    while (cnt > 0 && ' ' == buf[cnt - 1])
+		buf[--cnt] = '\0';
+	}
 	if ('\0' == buf[0])
 	    continue;
+	if (0 == ece391_strcmp (buf, (uint8_t*)"wait")) {
+	    reap_jobs (0);
+	    continue;
+	}
+	/* "exec cmd" replaces the shell with cmd */
+	if (0 == ece391_strncmp (buf, (uint8_t*)"exec ", 5)) {
+	    ece391_exec (buf + 5);
+	    ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    continue;
+	}
+	if (background) {
+	    if (-1 == (rval = ece391_spawn (buf))) {
+		ece391_fdputs (1, (uint8_t*)"no such command\n");
+		continue;
+	    }
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    ece391_fdputs (1, ece391_itoa (rval, num, 10));
+	    ece391_fdputs (1, (uint8_t*)"]\n");
+	    continue;
+	}
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
@@ -0,0 +1,101 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shared memory ping-pong.  Start "shmpp pong" on one terminal, then
+ * "shmpp ping" on another.  Each round trip ping writes a message into
+ * the shared segment, pong checks it and writes a reply, all in place
+ * with no kernel copies.  ping reports round trips and bytes per second.
+ */
+
+#define SEG_NAME     "shmpp"
+#define MSG_SIZE     4000
+#define RUN_TICKS    250         /* PIT ticks to run for (5 s at 50 Hz) */
+#define PIT_HZ       50
+#define BUFSIZE      32
+
+#define TURN_PING    0
+#define TURN_PONG    1
+#define TURN_DONE    2
+
+typedef struct channel {
+    volatile uint32_t turn;
+    volatile uint32_t seq;
+    uint8_t msg[MSG_SIZE];
+} channel_t;
+
+static int32_t ping (volatile channel_t* ch)
+{
+    ece391_stats_t start, now;
+    uint32_t trips = 0, i, ticks;
+
+    ece391_getstats (&start, sizeof (start));
+    do {
+        for (i = 0; i < MSG_SIZE; i++)
+            ch->msg[i] = (uint8_t)(trips + i);
+        ch->seq = trips;
+        ch->turn = TURN_PONG;
+        while (ch->turn == TURN_PONG);
+        trips++;
+        ece391_getstats (&now, sizeof (now));
+        ticks = now.pit_ticks - start.pit_ticks;
+    } while (ticks < RUN_TICKS);
+    ch->turn = TURN_DONE;
+
+    ece391_fdputu (1, (uint8_t*)"round trips:      ", trips);
+    ece391_fdputu (1, (uint8_t*)"round trips/s:    ", trips * PIT_HZ / ticks);
+    ece391_fdputu (1, (uint8_t*)"bytes/s (2 ways): ", (trips * PIT_HZ / ticks) * 2 * MSG_SIZE);
+    return 0;
+}
+
+static int32_t pong (volatile channel_t* ch)
+{
+    uint32_t i, bad = 0;
+
+    ece391_fdputs (1, (uint8_t*)"waiting for ping...\n");
+    while (1) {
+        while (ch->turn == TURN_PING);
+        if (ch->turn == TURN_DONE)
+            break;
+        for (i = 0; i < MSG_SIZE; i++) {
+            if (ch->msg[i] != (uint8_t)(ch->seq + i))
+                bad++;
+            ch->msg[i] = ~ch->msg[i];
+        }
+        ch->turn = TURN_PING;
+    }
+
+    ece391_fdputu (1, (uint8_t*)"corrupt bytes: ", bad);
+    return 0;
+}
+
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    volatile channel_t* ch = (volatile channel_t*)ECE391_SHM_BASE;
+    int32_t id, ret;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: shmpp ping|pong\n");
+        return 3;
+    }
+    if (-1 == (id = ece391_shm_open ((uint8_t*)SEG_NAME, sizeof (channel_t))) ||
+        -1 == ece391_shm_map (id, (void*)ch)) {
+        ece391_fdputs (1, (uint8_t*)"Can't map shared segment.\n");
+        return 2;
+    }
+
+    if (0 == ece391_strcmp (buf, (uint8_t*)"ping"))
+        ret = ping (ch);
+    else if (0 == ece391_strcmp (buf, (uint8_t*)"pong"))
+        ret = pong (ch);
+    else {
+        ece391_fdputs (1, (uint8_t*)"usage: shmpp ping|pong\n");
+        ret = 3;
+    }
+
+    ece391_shm_close (id);
+    return ret;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows how closely timeouts are kept now that they are timed by the
+ * local APIC against the tsc clock, instead of rounded up to whole 20 ms
+ * PIT ticks.  "sleepbench" sleeps ROUNDS times for each length in
+ * sleeps[] and reports the average time it really slept, in
+ * microseconds, measured with rdtsc and the kernel's tsc_per_us.
+ */
+
+#define ROUNDS       16
+
+static const uint32_t sleeps[] = { 100, 1000, 5000, 20000 };
+
+int main ()
+{
+    ece391_stats_t before, after;
+    uint32_t i, j, t0, cycles, tsc_per_us;
+
+    ece391_getstats (&before, sizeof (before));
+    if (0 == (tsc_per_us = before.tsc_per_us)) {
+        ece391_fdputs (1, (uint8_t*)"The kernel has no tsc clock.\n");
+        return 2;
+    }
+
+    for (i = 0; i < sizeof (sleeps) / sizeof (sleeps[0]); i++) {
+        cycles = 0;
+        for (j = 0; j < ROUNDS; j++) {
+            t0 = ece391_rdtsc ();
+            if (-1 == ece391_usleep (sleeps[i])) {
+                ece391_fdputs (1, (uint8_t*)"usleep failed\n");
+                return 3;
+            }
+            cycles += ece391_rdtsc () - t0;
+        }
+        ece391_fdputu (1, (uint8_t*)"asked for us:    ", sleeps[i]);
+        ece391_fdputu (1, (uint8_t*)"  slept us:      ", cycles / ROUNDS / tsc_per_us);
+    }
+    ece391_getstats (&after, sizeof (after));
+
+    ece391_fdputu (1, (uint8_t*)"sleeps:          ", after.timer_sleeps - before.timer_sleeps);
+    ece391_fdputu (1, (uint8_t*)"timer irqs:      ", after.timer_irqs - before.timer_irqs);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows whether cpu bound work spreads over the processors the kernel
+ * brought up.  "smpbench" times SPINS iterations of a busy loop once on
+ * its own, then the same loop in itself and CHILDREN forked children at
+ * once, and reports how many loops finished per the time one took, times
+ * 100.  With one cpu that stays near 100; with enough cpus for every
+ * worker it should approach (CHILDREN + 1) * 100.  The steals and
+ * migrations show how much of the spreading the load balancer did.  The
+ * shells of the other terminals already hold three of the six process
+ * slots.
+ */
+
+#define SPINS        20000000
+#define CHILDREN     2
+
+static void spin (void)
+{
+    volatile uint32_t i;
+
+    for (i = 0; i < SPINS; i++)
+        ;
+}
+
+int main ()
+{
+    ece391_stats_t before, after;
+    int32_t pids[CHILDREN];
+    uint32_t t0, alone, together, i;
+
+    t0 = ece391_rdtsc ();
+    spin ();
+    alone = ece391_rdtsc () - t0;
+
+    ece391_getstats (&before, sizeof (before));
+    t0 = ece391_rdtsc ();
+    for (i = 0; i < CHILDREN; i++) {
+        if (-1 == (pids[i] = ece391_fork ())) {
+            ece391_fdputs (1, (uint8_t*)"fork failed\n");
+            return 3;
+        }
+        if (0 == pids[i]) {
+            spin ();
+            ece391_halt (0);
+        }
+    }
+    spin ();
+    for (i = 0; i < CHILDREN; i++)
+        ece391_waitpid (pids[i], 0, 0);
+    together = ece391_rdtsc () - t0;
+
+    ece391_getstats (&after, sizeof (after));
+
+    alone /= 1000;
+    together /= 1000;
+    ece391_fdputu (1, (uint8_t*)"cpus online:        ", after.cpus_online);
+    ece391_fdputu (1, (uint8_t*)"workers:            ", CHILDREN + 1);
+    ece391_fdputu (1, (uint8_t*)"kcycles alone:      ", alone);
+    ece391_fdputu (1, (uint8_t*)"kcycles together:   ", together);
+    ece391_fdputu (1, (uint8_t*)"throughput x100:    ",
+                   together ? alone * (CHILDREN + 1) * 100 / together : 0);
+    ece391_fdputu (1, (uint8_t*)"steals:             ", after.sched_steals - before.sched_steals);
+    ece391_fdputu (1, (uint8_t*)"migrations:         ", after.sched_migrations - before.sched_migrations);
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Compares the startup of snapinit run from its image with starting it
+ * from a snapshot.  Runs "snapinit" ROUNDS times, then "snapinit snap"
+ * once to take the snapshot, then "snapinit" ROUNDS more times (now
+ * clones), and reports the average cycles per execute of each.  The
+ * snapshot is dropped again at the end.
+ */
+
+#define ROUNDS  8
+
+int main ()
+{
+    ece391_stats_t before, after;
+    uint32_t cold_cycles = 0, warm_cycles = 0, t0, i;
+
+    /* a snapshot left over from an interrupted run would skew the cold numbers */
+    ece391_snapshot_drop ((uint8_t*)"snapinit");
+
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        if (0 != ece391_execute ((uint8_t*)"snapinit")) {
+            ece391_fdputs (1, (uint8_t*)"snapinit failed\n");
+            return 3;
+        }
+        cold_cycles += ece391_rdtsc () - t0;
+    }
+
+    if (0 != ece391_execute ((uint8_t*)"snapinit snap")) {
+        ece391_fdputs (1, (uint8_t*)"snapshot failed\n");
+        return 3;
+    }
+
+    ece391_getstats (&before, sizeof (before));
+    for (i = 0; i < ROUNDS; i++) {
+        t0 = ece391_rdtsc ();
+        ece391_execute ((uint8_t*)"snapinit");
+        warm_cycles += ece391_rdtsc () - t0;
+    }
+    ece391_getstats (&after, sizeof (after));
+
+    ece391_snapshot_drop ((uint8_t*)"snapinit");
+
+    ece391_fdputu (1, (uint8_t*)"clones started:           ", after.snapshot_clones - before.snapshot_clones);
+    ece391_fdputu (1, (uint8_t*)"cycles per cold start:    ", cold_cycles / ROUNDS);
+    ece391_fdputu (1, (uint8_t*)"cycles per snapshot start:", warm_cycles / ROUNDS);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Stand-in for a program with a slow, deterministic startup.  Like fish
+ * it reads frame0.txt and frame1.txt and builds a blink entry for every
+ * screen cell from them, then exits.  "snapinit snap" takes a snapshot
+ * once the setup is done, so later runs skip straight to the end.  Timed
+ * by snapbench.
+ */
+
+#define NUM_CELLS    (80 * 25)
+#define FRAME_SIZE   4096
+
+struct blink {
+    uint8_t on_char;
+    uint8_t off_char;
+    uint16_t location;
+};
+
+static uint8_t frames[2][FRAME_SIZE];
+static struct blink blinks[NUM_CELLS];
+
+static int32_t read_frame (const uint8_t* name, uint8_t* buf)
+{
+    int32_t fd, cnt, total = 0;
+
+    if (-1 == (fd = ece391_open (name)))
+        return -1;
+    while (total < FRAME_SIZE &&
+           0 < (cnt = ece391_read (fd, buf + total, FRAME_SIZE - total)))
+        total += cnt;
+    ece391_close (fd);
+    return total;
+}
+
+int main (int argc, char** argv)
+{
+    int32_t len0, len1, i;
+
+    if (-1 == (len0 = read_frame ((uint8_t*)"frame0.txt", frames[0])) ||
+        -1 == (len1 = read_frame ((uint8_t*)"frame1.txt", frames[1]))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read the frame files.\n");
+        return 2;
+    }
+
+    for (i = 0; i < NUM_CELLS; i++) {
+        blinks[i].on_char = (i < len0 && frames[0][i] != '\n') ? frames[0][i] : ' ';
+        blinks[i].off_char = (i < len1 && frames[1][i] != '\n') ? frames[1][i] : ' ';
+        blinks[i].location = i;
+    }
+
+    if (argc > 1 && 0 == ece391_strcmp ((uint8_t*)argv[1], (uint8_t*)"snap"))
+        ece391_snapshot ((uint8_t*)"snapinit");
+
+    return 0;
+}
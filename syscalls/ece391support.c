@@ -102,3 +102,291 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/* Print "label" followed by an unsigned decimal number and a newline */
+void ece391_fdputu(int32_t fd, const uint8_t* label, uint32_t value)
+{
+    uint8_t buf[11];
+
+    ece391_fdputs (fd, label);
+    ece391_fdputs (fd, ece391_itoa (value, buf, 10));
+    ece391_fdputs (fd, (uint8_t*)"\n");
+}
+
+/* Low 32 bits of the time stamp counter, for timing short stretches */
+uint32_t ece391_rdtsc(void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+
+/*
+ * Heap allocator on top of ece391_sbrk.  Requests of up to MALLOC_MAX_SMALL
+ * bytes are rounded up to a power-of-two size class and served from that
+ * class's free list, which is refilled a page at a time.  Bigger requests
+ * get their own whole pages and go on a first-fit list when freed.
+ * The heap never shrinks.  Every block starts with a header holding its
+ * usable size, so free and realloc need no size argument.
+ */
+
+#define MALLOC_ALIGN        8
+#define MALLOC_MIN_SHIFT    4                   /* smallest class is 16 bytes */
+#define MALLOC_NUM_CLASSES  8                   /* 16 ... 2048 */
+#define MALLOC_MAX_SMALL    (1 << (MALLOC_MIN_SHIFT + MALLOC_NUM_CLASSES - 1))
+#define MALLOC_CHUNK        4096
+#define MALLOC_MAGIC        0x6D616C6C          /* "mall", cleared on free */
+
+typedef struct malloc_hdr {
+    uint32_t size;
+    uint32_t magic;
+} malloc_hdr_t;
+
+/* free blocks keep the list link where the data was */
+typedef struct malloc_free {
+    struct malloc_free* next;
+} malloc_free_t;
+
+static malloc_free_t* small_free[MALLOC_NUM_CLASSES];
+static malloc_free_t* large_free;
+static ece391_malloc_stats_t malloc_stats;
+static ece391_malloc_hook_t malloc_hook;
+
+#define HDR(ptr)    ((malloc_hdr_t*)(ptr) - 1)
+
+/* anything bigger would wrap when rounded up, or go negative in sbrk */
+#define MALLOC_MAX_LARGE    (INT32_MAX - sizeof (malloc_hdr_t) - MALLOC_CHUNK)
+
+/* Size class index for size, or -1 if it is a large request */
+static int32_t size_class (uint32_t size)
+{
+    int32_t cls = 0;
+
+    if (size > MALLOC_MAX_SMALL)
+        return -1;
+    while ((1U << (MALLOC_MIN_SHIFT + cls)) < size)
+        cls++;
+    return cls;
+}
+
+/* Grows the heap, keeping the counters up to date */
+static void* heap_grow (uint32_t bytes)
+{
+    void* mem;
+
+    if ((void*)-1 == (mem = ece391_sbrk (bytes)))
+        return 0;
+    malloc_stats.heap_bytes += bytes;
+    malloc_stats.sbrk_calls++;
+    return mem;
+}
+
+/* Carves a fresh chunk into blocks of class cls */
+static int32_t refill_class (int32_t cls)
+{
+    uint32_t block = sizeof (malloc_hdr_t) + (1U << (MALLOC_MIN_SHIFT + cls));
+    uint8_t* chunk;
+    uint32_t off;
+    malloc_hdr_t* hdr;
+    malloc_free_t* blk;
+
+    if (0 == (chunk = heap_grow (MALLOC_CHUNK)))
+        return -1;
+    for (off = 0; off + block <= MALLOC_CHUNK; off += block) {
+        hdr = (malloc_hdr_t*)(chunk + off);
+        hdr->size = block - sizeof (malloc_hdr_t);
+        hdr->magic = 0;
+        blk = (malloc_free_t*)(hdr + 1);
+        blk->next = small_free[cls];
+        small_free[cls] = blk;
+    }
+    return 0;
+}
+
+/* Takes a large block of at least size bytes off the free list */
+static void* take_large (uint32_t size)
+{
+    malloc_free_t** link;
+    malloc_free_t* blk;
+
+    for (link = &large_free; 0 != *link; link = &(*link)->next) {
+        if (HDR (*link)->size >= size) {
+            blk = *link;
+            *link = blk->next;
+            return blk;
+        }
+    }
+    return 0;
+}
+
+void* ece391_malloc (uint32_t size)
+{
+    int32_t cls;
+    void* ptr;
+    malloc_hdr_t* hdr;
+
+    if (0 == size)
+        size = 1;
+
+    if (-1 != (cls = size_class (size))) {
+        if (0 == small_free[cls] && -1 == refill_class (cls)) {
+            malloc_stats.failures++;
+            return 0;
+        }
+        ptr = small_free[cls];
+        small_free[cls] = small_free[cls]->next;
+    } else {
+        if (size > MALLOC_MAX_LARGE) {
+            malloc_stats.failures++;
+            return 0;
+        }
+        /* whole pages, so a growing realloc does not move every time */
+        size = ((sizeof (malloc_hdr_t) + size + MALLOC_CHUNK - 1) & ~(MALLOC_CHUNK - 1)) -
+               sizeof (malloc_hdr_t);
+        if (0 == (ptr = take_large (size))) {
+            if (0 == (hdr = heap_grow (sizeof (malloc_hdr_t) + size))) {
+                malloc_stats.failures++;
+                return 0;
+            }
+            hdr->size = size;
+            ptr = hdr + 1;
+        }
+    }
+
+    hdr = HDR (ptr);
+    hdr->magic = MALLOC_MAGIC;
+    malloc_stats.mallocs++;
+    malloc_stats.bytes_in_use += hdr->size;
+    if (malloc_stats.bytes_in_use > malloc_stats.peak_bytes_in_use)
+        malloc_stats.peak_bytes_in_use = malloc_stats.bytes_in_use;
+    if (0 != malloc_hook)
+        malloc_hook (ECE391_MALLOC_ALLOC, ptr, hdr->size);
+    return ptr;
+}
+
+void ece391_free (void* ptr)
+{
+    malloc_hdr_t* hdr;
+    malloc_free_t* blk = ptr;
+    int32_t cls;
+
+    if (0 == ptr)
+        return;
+    hdr = HDR (ptr);
+    if (MALLOC_MAGIC != hdr->magic) {
+        malloc_stats.bad_frees++;
+        return;
+    }
+    hdr->magic = 0;
+
+    malloc_stats.frees++;
+    malloc_stats.bytes_in_use -= hdr->size;
+    if (0 != malloc_hook)
+        malloc_hook (ECE391_MALLOC_FREE, ptr, hdr->size);
+
+    /* small blocks always hold exactly their class size */
+    if (-1 != (cls = size_class (hdr->size))) {
+        blk->next = small_free[cls];
+        small_free[cls] = blk;
+    } else {
+        blk->next = large_free;
+        large_free = blk;
+    }
+}
+
+void* ece391_calloc (uint32_t nmemb, uint32_t size)
+{
+    uint8_t* ptr;
+    uint32_t total = nmemb * size, i;
+
+    if (0 != size && total / size != nmemb)
+        return 0;
+    if (0 == (ptr = ece391_malloc (total)))
+        return 0;
+    /* recycled blocks are not zero */
+    for (i = 0; i < total; i++)
+        ptr[i] = 0;
+    return ptr;
+}
+
+void* ece391_realloc (void* ptr, uint32_t size)
+{
+    uint8_t* new_ptr;
+    uint32_t old_size, i;
+
+    if (0 == ptr)
+        return ece391_malloc (size);
+    if (0 == size) {
+        ece391_free (ptr);
+        return 0;
+    }
+
+    /* same check as ece391_free, which this would end up calling */
+    if (MALLOC_MAGIC != HDR (ptr)->magic) {
+        malloc_stats.bad_frees++;
+        return 0;
+    }
+    old_size = HDR (ptr)->size;
+    if (size <= old_size)
+        return ptr;
+
+    if (0 == (new_ptr = ece391_malloc (size)))
+        return 0;
+    for (i = 0; i < old_size; i++)
+        new_ptr[i] = ((uint8_t*)ptr)[i];
+    ece391_free (ptr);
+    malloc_stats.reallocs++;
+    return new_ptr;
+}
+
+void ece391_malloc_stats (ece391_malloc_stats_t* stats)
+{
+    *stats = malloc_stats;
+}
+
+void ece391_malloc_set_hook (ece391_malloc_hook_t hook)
+{
+    malloc_hook = hook;
+}
+
+
+/*
+ * Bump-pointer arenas for things that all die together.  One block is
+ * taken from ece391_malloc up front; allocating only moves a pointer and
+ * nothing is freed on its own.  ece391_arena_reset hands the whole block
+ * out again, ece391_arena_destroy gives it back.
+ */
+
+int32_t ece391_arena_init (ece391_arena_t* arena, uint32_t size)
+{
+    if (0 == (arena->base = ece391_malloc (size)))
+        return -1;
+    arena->size = size;
+    arena->used = 0;
+    return 0;
+}
+
+void* ece391_arena_alloc (ece391_arena_t* arena, uint32_t size)
+{
+    uint32_t start = (arena->used + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+
+    if (start > arena->size || size > arena->size - start)
+        return 0;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+void ece391_arena_reset (ece391_arena_t* arena)
+{
+    arena->used = 0;
+}
+
+void ece391_arena_destroy (ece391_arena_t* arena)
+{
+    ece391_free (arena->base);
+    arena->base = 0;
+    arena->size = 0;
+    arena->used = 0;
+}
@@ -8,6 +8,51 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern void ece391_fdputu(int32_t fd, const uint8_t* label, uint32_t value);
+extern uint32_t ece391_rdtsc(void);
+
+/*
+ * malloc/free on top of ece391_sbrk.  Small requests come from per-size
+ * free lists, so free and malloc of the same size are a few instructions.
+ * Memory is never given back to the kernel.  Freeing a pointer that did
+ * not come from ece391_malloc (or freeing twice) is counted and ignored;
+ * reallocating one is counted the same way and returns 0.
+ */
+typedef struct ece391_malloc_stats {
+    uint32_t mallocs;
+    uint32_t frees;
+    uint32_t reallocs;              /* reallocs that had to move the data */
+    uint32_t failures;              /* the heap could not grow */
+    uint32_t bad_frees;
+    uint32_t bytes_in_use;          /* usable bytes of live blocks */
+    uint32_t peak_bytes_in_use;
+    uint32_t heap_bytes;            /* taken from the kernel with sbrk */
+    uint32_t sbrk_calls;
+} ece391_malloc_stats_t;
+
+/* called on every malloc and free, e.g. to trace a program's allocations */
+#define ECE391_MALLOC_ALLOC 0
+#define ECE391_MALLOC_FREE  1
+typedef void (*ece391_malloc_hook_t)(int32_t event, void* ptr, uint32_t size);
+
+extern void* ece391_malloc(uint32_t size);
+extern void ece391_free(void* ptr);
+extern void* ece391_calloc(uint32_t nmemb, uint32_t size);
+extern void* ece391_realloc(void* ptr, uint32_t size);
+extern void ece391_malloc_stats(ece391_malloc_stats_t* stats);
+extern void ece391_malloc_set_hook(ece391_malloc_hook_t hook);
+
+/* bump-pointer arena: allocations are only freed all at once */
+typedef struct ece391_arena {
+    uint8_t* base;
+    uint32_t size;
+    uint32_t used;
+} ece391_arena_t;
+
+extern int32_t ece391_arena_init(ece391_arena_t* arena, uint32_t size);
+extern void* ece391_arena_alloc(ece391_arena_t* arena, uint32_t size);
+extern void ece391_arena_reset(ece391_arena_t* arena);
+extern void ece391_arena_destroy(ece391_arena_t* arena);
 
 #endif /* ECE391SUPPORT_H */
 
@@ -0,0 +1,99 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Times context switches with a ping-pong between two processes.  The
+ * parent forks a child and the two pass a turn back and forth ROUNDS
+ * times through a shared segment, sleeping a microsecond whenever it is
+ * not theirs, so every pass hands the cpu to the other process or to the
+ * idle task.  The kernel's switch counters give the cycles per switch
+ * and how many switches kept the loaded page directory.  "alone" does
+ * the same sleeps in one process; each switch then goes to idle and
+ * back, and should almost never reload cr3.
+ */
+
+#define SEG_NAME     "switchbench"
+#define SEG_ADDR     (ECE391_SHM_BASE + 0x100000)
+#define ROUNDS       2000
+
+#define TURN_PARENT  0
+#define TURN_CHILD   1
+
+typedef struct turn {
+    volatile uint32_t whose;
+} turn_t;
+
+static void pass (turn_t* t, uint32_t me, uint32_t other)
+{
+    uint32_t i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        while (t->whose != me)
+            ece391_usleep (1);
+        t->whose = other;
+    }
+}
+
+static void report (const char* label, ece391_stats_t* before,
+                    ece391_stats_t* after, uint32_t cycles)
+{
+    uint32_t switches, skips;
+
+    switches = after->ctx_switches - before->ctx_switches;
+    skips = after->ctx_switch_cr3_skips - before->ctx_switch_cr3_skips;
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputu (1, (uint8_t*)"  context switches:   ", switches);
+    if (switches != 0) {
+        ece391_fdputu (1, (uint8_t*)"  cycles per switch:  ",
+                       (after->ctx_switch_cycles - before->ctx_switch_cycles) / switches);
+        ece391_fdputu (1, (uint8_t*)"  cr3 kept, percent:  ", skips * 100 / switches);
+    }
+    ece391_fdputu (1, (uint8_t*)"  cycles per round:   ", cycles / ROUNDS);
+}
+
+int main ()
+{
+    ece391_stats_t before, after;
+    turn_t* t = (turn_t*)SEG_ADDR;
+    int32_t id, pid;
+    uint32_t t0, i;
+
+    if (-1 == ece391_getstats (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read kernel stats.\n");
+        return 3;
+    }
+    t0 = ece391_rdtsc ();
+    for (i = 0; i < ROUNDS; i++)
+        ece391_usleep (1);
+    t0 = ece391_rdtsc () - t0;
+    ece391_getstats (&after, sizeof (after));
+    report ("alone\n", &before, &after, t0);
+
+    if (-1 == (id = ece391_shm_open ((uint8_t*)SEG_NAME, sizeof (turn_t))) ||
+        -1 == ece391_shm_map (id, (void*)t)) {
+        ece391_fdputs (1, (uint8_t*)"Can't map shared memory.\n");
+        return 2;
+    }
+    t->whose = TURN_PARENT;
+
+    ece391_getstats (&before, sizeof (before));
+    t0 = ece391_rdtsc ();
+    if (-1 == (pid = ece391_fork ())) {
+        ece391_fdputs (1, (uint8_t*)"fork failed\n");
+        return 3;
+    }
+    if (0 == pid) {
+        pass (t, TURN_CHILD, TURN_PARENT);
+        ece391_halt (0);
+    }
+    pass (t, TURN_PARENT, TURN_CHILD);
+    ece391_waitpid (pid, 0, 0);
+    t0 = ece391_rdtsc () - t0;
+    ece391_getstats (&after, sizeof (after));
+    ece391_shm_close (id);
+    report ("ping-pong\n", &before, &after, t0);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Reports how often the scheduler switches tasks and what each switch
+ * costs.  Run something on the other terminals first (e.g. counter or
+ * pingpong) so there is more than one task to switch between.
+ */
+
+#define RTC_FREQ     16
+#define SAMPLE_TICKS 64
+
+int main ()
+{
+    ece391_stats_t before, after;
+    int32_t rtc_fd, freq, garbage, i;
+    uint32_t switches, cycles, ticks;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"Can't open rtc.\n");
+        return 2;
+    }
+    freq = RTC_FREQ;
+    ece391_write (rtc_fd, &freq, 4);
+
+    if (-1 == ece391_getstats (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read kernel stats.\n");
+        return 3;
+    }
+    for (i = 0; i < SAMPLE_TICKS; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_getstats (&after, sizeof (after));
+    ece391_close (rtc_fd);
+
+    ticks = after.pit_ticks - before.pit_ticks;
+    switches = after.ctx_switches - before.ctx_switches;
+    cycles = after.ctx_switch_cycles - before.ctx_switch_cycles;
+
+    ece391_fdputu (1, (uint8_t*)"pit ticks:          ", ticks);
+    ece391_fdputu (1, (uint8_t*)"context switches:   ", switches);
+    if (switches != 0)
+        ece391_fdputu (1, (uint8_t*)"cycles per switch:  ", cycles / switches);
+
+    return 0;
+}
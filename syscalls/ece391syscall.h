@@ -22,6 +22,172 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Programs are entered as main (argc, argv, envp).  argv[0] is the program
+ * name and argv[argc] is NULL; envp is a NULL-terminated list of NAME=value
+ * strings inherited from the parent.  Together they may take up to 1024
+ * bytes.  ece391_getargs still returns argv[1..] joined by single spaces.
+ */
+
+/*
+ * Kernel performance counters, filled in by ece391_getstats.  The layout
+ * mirrors kstats_t in the kernel; counters wrap, so always take deltas.
+ */
+typedef struct ece391_stats {
+    uint32_t pit_ticks;
+    uint32_t ctx_switches;
+    uint32_t ctx_switch_cycles;
+    uint32_t tlb_full_flushes;
+    uint32_t tlb_page_flushes;
+    uint32_t page_faults;
+    uint32_t pages_zeroed;
+    uint32_t forks;
+    uint32_t cow_copies;
+    uint32_t zero_pool_depth;
+    uint32_t zero_pool_hits;
+    uint32_t zero_pool_misses;
+    uint32_t boot_ready_cycles;
+    uint32_t boot_ready_ticks;
+    uint32_t snapshot_clones;
+    uint32_t vid_flips;
+    uint32_t wait_sleeps;
+    uint32_t idle_ticks;
+    uint32_t sched_demotions;
+    uint32_t sched_boosts;
+    uint32_t timer_irqs;
+    uint32_t tsc_per_us;
+    uint32_t timer_sleeps;
+    uint32_t cpus_online;
+    uint32_t resched_ipis;
+    uint32_t sched_steals;
+    uint32_t sched_migrations;
+    uint32_t irq_off_max_cycles;
+    uint32_t lock_order_violations;
+    uint32_t ctx_switch_cr3_skips;
+} ece391_stats_t;
+
+extern int32_t ece391_getstats (ece391_stats_t* buf, int32_t nbytes);
+
+/*
+ * The heap starts empty right after the vidmap page.  Growing it only
+ * moves the break; each 4 kB page is zero-filled on first touch.
+ * ece391_sbrk returns the old break, or (void*)-1 on failure.  It can
+ * reach 56 MB.  The stack lives on its own below 512 MB and grows a page
+ * at a time, up to 8 MB, so deep recursion and big local arrays no longer
+ * run into the program image.
+ */
+extern int32_t ece391_brk (void* addr);
+extern void* ece391_sbrk (int32_t increment);
+
+/*
+ * Named shared memory.  ece391_shm_open creates the segment (zero-filled,
+ * at most 64 pages) or opens an existing one and returns its id.
+ * ece391_shm_map maps it at a page-aligned address in [192MB, 256MB).
+ * The pages are freed once every process has closed the segment (or
+ * halted).
+ */
+#define ECE391_SHM_BASE 0x0C000000
+extern int32_t ece391_shm_open (const uint8_t* name, uint32_t size);
+extern int32_t ece391_shm_map (int32_t id, void* addr);
+extern int32_t ece391_shm_close (int32_t id);
+
+/*
+ * Duplicates the calling process.  Returns the child's pid in the parent
+ * and 0 in the child.  Pages are shared until either side writes them.
+ * The parent does not wait for the child; collect it with ece391_waitpid.
+ */
+extern int32_t ece391_fork (void);
+
+/*
+ * Starts a program like ece391_execute, but returns the child's pid right
+ * away and leaves it running in the background.  ece391_waitpid blocks
+ * until the child (or any child for ECE391_WAIT_ANY) halts, stores its
+ * status and returns its pid.  Children that are never waited for keep
+ * their process slot until the parent halts.
+ */
+#define ECE391_WAIT_ANY (-1)
+#define ECE391_WNOHANG  1
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+/*
+ * Replaces the calling program with another one, keeping the process
+ * (its slot, open files, parent and terminal).  Only returns, with -1,
+ * if the program does not exist.
+ */
+extern int32_t ece391_exec (const uint8_t* command);
+
+/*
+ * Saves the calling process (memory, registers, open files) under name,
+ * which must be the name of the program it was started from.  From then
+ * on ece391_execute or ece391_spawn of that program starts a
+ * copy-on-write clone that resumes here instead of running the program
+ * from the top.  The clone's argv and envp are the ones it was launched
+ * with; a launch whose arguments take more room than the snapshot's
+ * starts from the top after all.  Returns 0 in the caller and in every
+ * clone.  Fails while shared memory is open.  ece391_snapshot_drop goes
+ * back to normal startup.
+ */
+extern int32_t ece391_snapshot (const uint8_t* name);
+extern int32_t ece391_snapshot_drop (const uint8_t* name);
+
+/*
+ * Memory use of the whole system and of every process slot, filled in by
+ * ece391_meminfo.  Mirrors meminfo_t in the kernel.  Page counts are 4 kB
+ * pages; shared_pages are the ones also mapped by another process or a
+ * snapshot (copy on write or shared memory), so they must not be summed
+ * across processes.
+ */
+#define ECE391_MAX_PROCS  6
+#define ECE391_NO_PID     (-1)
+typedef struct ece391_proc_mem {
+    int32_t pid;
+    int32_t parent;
+    uint32_t tid;
+    uint32_t state;
+    uint32_t image_pages;
+    uint32_t heap_pages;
+    uint32_t shm_pages;
+    uint32_t shared_pages;
+    uint32_t page_tables;
+    uint32_t vidmap;
+    uint32_t kernel_bytes;
+    uint32_t stack_pages;
+} ece391_proc_mem_t;
+
+typedef struct ece391_meminfo {
+    uint32_t total_frames;
+    uint32_t free_frames;
+    uint32_t zeroed_frames;
+    uint32_t processes;
+    uint32_t shm_segments;
+    uint32_t shm_pages;
+    uint32_t snapshots;
+    uint32_t snapshot_pages;
+    ece391_proc_mem_t procs[ECE391_MAX_PROCS];
+} ece391_meminfo_t;
+
+extern int32_t ece391_meminfo (ece391_meminfo_t* buf, int32_t nbytes);
+
+/*
+ * Double-buffered text mode.  After ece391_vidmap the terminal's back
+ * buffer is mapped ECE391_VID_BACK_OFFSET bytes past the screen, holding
+ * a copy of what was on screen.  Draw a whole frame there, then
+ * ece391_vid_flip copies it to the screen at once.  With sync set it
+ * first waits for the next RTC interrupt, at the rate last written to
+ * the rtc.  Processes on the same terminal share the back buffer.
+ */
+#define ECE391_VID_BACK_OFFSET 0x1000
+extern int32_t ece391_vid_flip (int32_t sync);
+
+/*
+ * Sleeps for at least us microseconds without using the cpu.  The kernel
+ * times it with the local APIC timer against a tsc clock, so short sleeps
+ * end close to on time; tsc_per_us in ece391_stats_t converts rdtsc
+ * cycles to the same unit.
+ */
+extern int32_t ece391_usleep (uint32_t us);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
@@ -11,5 +11,20 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_GETSTATS   11
+#define SYS_BRK        12
+#define SYS_SBRK       13
+#define SYS_SHM_OPEN   14
+#define SYS_SHM_MAP    15
+#define SYS_SHM_CLOSE  16
+#define SYS_FORK       17
+#define SYS_SPAWN      18
+#define SYS_WAITPID    19
+#define SYS_EXEC       20
+#define SYS_SNAPSHOT   21
+#define SYS_SNAPSHOT_DROP 22
+#define SYS_MEMINFO    23
+#define SYS_VID_FLIP   24
+#define SYS_USLEEP     25
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Reports how many timer interrupts the kernel takes per second against
+ * the fixed-rate ticks it used to take.  The first phase sleeps on the RTC
+ * for SECONDS, so nothing is runnable.  The second forks a child and both
+ * spin for SECONDS, so quanta have to be timed and the timer fires once a
+ * tick.  "ticks/s" is the tick rate time was counted in; "irqs/s" is what
+ * was really taken, from the local APIC timer or the PIT.
+ */
+
+#define RTC_RATE     32
+#define SECONDS      2
+#define HZ           50
+
+static void report (const uint8_t* what, ece391_stats_t* before, ece391_stats_t* after)
+{
+    ece391_fdputs (1, what);
+    ece391_fdputu (1, (uint8_t*)"  ticks/s: ", (after->pit_ticks - before->pit_ticks) / SECONDS);
+    ece391_fdputu (1, (uint8_t*)"  irqs/s:  ", (after->timer_irqs - before->timer_irqs) / SECONDS);
+}
+
+static void spin_until (uint32_t tick)
+{
+    ece391_stats_t now;
+
+    do {
+        ece391_getstats (&now, sizeof (now));
+    } while (now.pit_ticks < tick);
+}
+
+int main ()
+{
+    ece391_stats_t before, after;
+    int32_t rtc_fd, rate = RTC_RATE, garbage, pid;
+    uint32_t i;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"Can't open the rtc.\n");
+        return 2;
+    }
+    ece391_write (rtc_fd, &rate, 4);
+
+    ece391_getstats (&before, sizeof (before));
+    for (i = 0; i < RTC_RATE * SECONDS; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_getstats (&after, sizeof (after));
+    ece391_close (rtc_fd);
+    report ((uint8_t*)"sleeping:\n", &before, &after);
+
+    ece391_getstats (&before, sizeof (before));
+    if (-1 == (pid = ece391_fork ())) {
+        ece391_fdputs (1, (uint8_t*)"fork failed\n");
+        return 3;
+    }
+    spin_until (before.pit_ticks + HZ * SECONDS);
+    if (0 == pid)
+        ece391_halt (0);
+    ece391_getstats (&after, sizeof (after));
+    ece391_waitpid (pid, 0, 0);
+    report ((uint8_t*)"two tasks spinning:\n", &before, &after);
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Reports how many full tlb flushes (cr3 loads) and single-page
+ * invalidations the kernel does per second.  Start a workload on all
+ * three terminals (e.g. fish, pingpong and counter) and switch between
+ * them with Alt+F1/F2/F3 while this runs.
+ */
+
+#define RTC_FREQ       16
+#define SAMPLE_SECONDS 8
+
+int main ()
+{
+    ece391_stats_t before, after;
+    int32_t rtc_fd, freq, garbage, i;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"Can't open rtc.\n");
+        return 2;
+    }
+    freq = RTC_FREQ;
+    ece391_write (rtc_fd, &freq, 4);
+
+    if (-1 == ece391_getstats (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read kernel stats.\n");
+        return 3;
+    }
+    for (i = 0; i < RTC_FREQ * SAMPLE_SECONDS; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_getstats (&after, sizeof (after));
+    ece391_close (rtc_fd);
+
+    ece391_fdputu (1, (uint8_t*)"full flushes/s:     ",
+                   (after.tlb_full_flushes - before.tlb_full_flushes) / SAMPLE_SECONDS);
+    ece391_fdputu (1, (uint8_t*)"invlpg/s:           ",
+                   (after.tlb_page_flushes - before.tlb_page_flushes) / SAMPLE_SECONDS);
+    ece391_fdputu (1, (uint8_t*)"context switches/s: ",
+                   (after.ctx_switches - before.ctx_switches) / SAMPLE_SECONDS);
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows how well the kernel's pool of pre-zeroed frames keeps up.  Touches
+ * TOUCH_PAGES fresh heap pages, each of which needs a zeroed frame, and
+ * reports how many were served from the pool.  The pool refills while
+ * tasks wait for the keyboard or the rtc, so run it twice in a row to see
+ * the difference an idle pause makes.
+ */
+
+#define TOUCH_PAGES  32
+#define PAGE_SIZE    4096
+
+int main ()
+{
+    ece391_stats_t before, after;
+    uint8_t* heap;
+    uint32_t hits, misses, i;
+
+    if (-1 == ece391_getstats (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"Can't read kernel stats.\n");
+        return 3;
+    }
+    if ((void*)-1 == (heap = ece391_sbrk (TOUCH_PAGES * PAGE_SIZE))) {
+        ece391_fdputs (1, (uint8_t*)"Can't grow the heap.\n");
+        return 2;
+    }
+    for (i = 0; i < TOUCH_PAGES; i++)
+        heap[i * PAGE_SIZE] = 1;
+    ece391_getstats (&after, sizeof (after));
+
+    hits = after.zero_pool_hits - before.zero_pool_hits;
+    misses = after.zero_pool_misses - before.zero_pool_misses;
+
+    ece391_fdputu (1, (uint8_t*)"pool depth before:  ", before.zero_pool_depth);
+    ece391_fdputu (1, (uint8_t*)"pool depth after:   ", after.zero_pool_depth);
+    ece391_fdputu (1, (uint8_t*)"served from pool:   ", hits);
+    ece391_fdputu (1, (uint8_t*)"zeroed on demand:   ", misses);
+    if (hits + misses != 0)
+        ece391_fdputu (1, (uint8_t*)"pool hit percent:   ", hits * 100 / (hits + misses));
+    ece391_fdputu (1, (uint8_t*)"lifetime hits:      ", after.zero_pool_hits);
+    ece391_fdputu (1, (uint8_t*)"lifetime misses:    ", after.zero_pool_misses);
+
+    return 0;
+}